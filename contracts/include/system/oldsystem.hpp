@@ -4,6 +4,7 @@
 #include <eosio/eosio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace system_origin {
     using namespace eosio;
@@ -80,6 +81,17 @@ namespace system_origin {
         return out;
     }
 
+    // REX
+    struct [[eosio::table, eosio::contract("eosio.system")]] rex_fund {
+        uint8_t version = 0;
+        name    owner;
+        asset   balance;
+
+        uint64_t primary_key()const { return owner.value; }
+    };
+
+    typedef eosio::multi_index< "rexfund"_n, rex_fund > rex_fund_table;
+
     // DELEGATE BW / VOTING
     struct [[eosio::table, eosio::contract("eosio.system")]] refund_request {
         name            owner;
@@ -91,4 +103,21 @@ namespace system_origin {
     };
 
     typedef eosio::multi_index< "refunds"_n, refund_request > refunds_table;
+
+    struct [[eosio::table, eosio::contract("eosio.system")]] voter_info {
+        name                owner;
+        name                proxy;
+        std::vector<name>   producers;
+        int64_t             staked = 0;
+        double              last_vote_weight = 0;
+        double              proxied_vote_weight = 0;
+        bool                is_proxy = 0;
+        uint32_t            flags1 = 0;
+        uint32_t            reserved2 = 0;
+        eosio::asset        reserved3;
+
+        uint64_t  primary_key()const { return owner.value; }
+    };
+
+    typedef eosio::multi_index< "voters"_n, voter_info > voters_table;
 }
\ No newline at end of file
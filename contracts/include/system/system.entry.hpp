@@ -4,29 +4,43 @@
 #include <eosio/singleton.hpp>
 #include <eosio/binary_extension.hpp>
 
+#include <system/usage.hpp>
+#include <system/versioned.hpp>
+
 namespace system_origin {
 struct authority;
 };
 
 class [[eosio::contract("system")]] system_contract : public eosio::contract {
 public:
-   using contract::contract;
    using name   = eosio::name;
    using asset  = eosio::asset;
    using symbol = eosio::symbol;
 
+   // `accounts`, `stat`, `config` and `blocked` rows are versioned, see system/versioned.hpp.
    struct [[eosio::table("accounts"), eosio::contract("system")]] account {
       asset    balance;
       bool     released = false;
+      eosio::binary_extension<uint8_t> version;
+
+      static constexpr uint8_t current_version = SYSTEM_ROW_VERSION(0);
+      void upgrade_from(uint8_t version) {} // no layout change yet, see SYSTEM_ROW_VERSION
       uint64_t primary_key()const { return balance.symbol.code().raw(); }
+
+      SYSTEM_VERSIONED_SERIALIZE(account, (balance)(released))
    };
 
    struct [[eosio::table("stat"), eosio::contract("system")]] currency_stats {
       asset    supply;
       asset    max_supply;
       name     issuer;
+      eosio::binary_extension<uint8_t> version;
 
+      static constexpr uint8_t current_version = SYSTEM_ROW_VERSION(0);
+      void upgrade_from(uint8_t version) {} // no layout change yet, see SYSTEM_ROW_VERSION
       uint64_t primary_key()const { return supply.symbol.code().raw(); }
+
+      SYSTEM_VERSIONED_SERIALIZE(currency_stats, (supply)(max_supply)(issuer))
    };
 
    typedef eosio::multi_index< "accounts"_n, account > accounts;
@@ -34,21 +48,193 @@ public:
 
    struct [[eosio::table]] config {
       symbol token_symbol;
+      eosio::binary_extension<uint8_t> version;
+
+      static constexpr uint8_t current_version = SYSTEM_ROW_VERSION(0);
+      void upgrade_from(uint8_t version) {} // no layout change yet, see SYSTEM_ROW_VERSION
+
+      SYSTEM_VERSIONED_SERIALIZE(config, (token_symbol))
    };
 
    typedef eosio::singleton<"config"_n, config> config_table;
 
+   // Running totals for the XYZ token, kept up to date by `add_balance`, `sub_balance`, `open` and `close`
+   // so that they can be read in a single lookup instead of scanning every scope.
+   // - `circulating` is the supply minus what this contract holds.
+   // - `holders` counts accounts other than this contract with a non-zero balance.
+   // - `contract_rows` counts unreleased rows holding a balance. This contract pays their RAM, except for the rare
+   //   ones `open` created on behalf of their owner, which stay with whoever opened them.
+   // - `sponsored_rows` counts unreleased rows `open` created on behalf of their owner that hold no balance yet; on
+   //   their first credit they move to `contract_rows`.
+   // Rows don't record who pays for them, so the counts follow from the balance: unreleased rows this contract
+   // creates always start with a balance, and are released on their first debit, before they can drain to zero.
+   // The counts only see changes made after they were introduced; `setaggr` seeds `holders` and `contract_rows`.
+   static constexpr uint64_t account_row_bytes = 241; // balance row plus its scope overhead
+
+   struct [[eosio::table]] token_aggregates {
+      asset    circulating;
+      uint64_t holders            = 0;
+      uint64_t contract_rows      = 0;
+      uint64_t contract_ram_bytes = 0;
+      uint64_t sponsored_rows     = 0;
+   };
+
+   typedef eosio::singleton<"aggregates"_n, token_aggregates> aggregates_table;
+
    // allow account owners to disallow the `swapto` action with their account as destination.
    // This has been requested by exchanges who prefer to receive funds into their hot wallets
    // exclusively via the root `transfer` action.
    struct [[eosio::table]] blocked_recipient {
       name account;
+      eosio::binary_extension<uint8_t> version;
 
+      static constexpr uint8_t current_version = SYSTEM_ROW_VERSION(0);
+      void upgrade_from(uint8_t version) {} // no layout change yet, see SYSTEM_ROW_VERSION
       uint64_t primary_key() const { return account.value; }
+
+      SYSTEM_VERSIONED_SERIALIZE(blocked_recipient, (account))
    };
 
    typedef eosio::multi_index<"blocked"_n, blocked_recipient> blocked_table;
 
+   // Progress of the background `migrate` pass over the versioned tables.
+   enum class migrate_stage : uint8_t { config = 0, stat = 1, blocked = 2, done = 3 };
+
+   struct [[eosio::table]] migrate_state {
+      uint8_t  stage = 0;
+      uint64_t next  = 0; // primary key of the next row to visit in the current table
+   };
+
+   typedef eosio::singleton<"migratestate"_n, migrate_state> migrate_state_table;
+
+   // Client nonces used with `transfer` and `swapto`, so that exchanges can safely retry a request after a
+   // timeout without looking it up on a history node. Each nonce is remembered for `nonce_ttl_sec`, and
+   // every call erases a few expired entries so the table only ever holds one TTL worth of nonces.
+   static constexpr uint32_t nonce_ttl_sec     = 24 * 60 * 60;
+   static constexpr uint32_t nonce_gc_per_call = 2;
+
+   struct [[eosio::table]] used_nonce {
+      uint64_t              id;
+      name                  account;
+      uint64_t              nonce;
+      eosio::time_point_sec expires;
+
+      uint64_t  primary_key() const { return id; }
+      uint128_t by_account_nonce() const { return (uint128_t(account.value) << 64) | nonce; }
+      uint64_t  by_expiry() const { return expires.sec_since_epoch(); }
+   };
+
+   typedef eosio::multi_index<"nonces"_n, used_nonce,
+      eosio::indexed_by<"byacctnonce"_n, eosio::const_mem_fun<used_nonce, uint128_t, &used_nonce::by_account_nonce>>,
+      eosio::indexed_by<"byexpiry"_n, eosio::const_mem_fun<used_nonce, uint64_t, &used_nonce::by_expiry>>>
+      nonces_table;
+
+   // Keys that accounts register to sign swap intents off-chain, along with the last intent nonce
+   // a relayer executed for them.
+   struct [[eosio::table]] relay_account {
+      name              account;
+      eosio::public_key key;
+      uint64_t          nonce = 0;
+
+      uint64_t primary_key() const { return account.value; }
+   };
+
+   typedef eosio::multi_index<"relaykeys"_n, relay_account> relay_table;
+
+   // Usage counters, scoped by the name of the action that was called. Each row counts the calls made and
+   // the amounts swapped in each direction. Every EOS to XYZ swap is recorded under `transfer` (they all
+   // arrive through an `eosio.token` transfer), so summing a direction over all scopes gives its total volume.
+   // Callers are spread over `counter_shards` rows per scope so that busy actions don't share a single hot row.
+   static constexpr uint64_t counter_shards = system_usage::counter_shards;
+
+   struct [[eosio::table]] usage_counter {
+      uint64_t shard;
+      uint64_t calls      = 0;
+      int64_t  eos_to_xyz = 0;
+      int64_t  xyz_to_eos = 0;
+
+      uint64_t primary_key() const { return shard; }
+   };
+
+   typedef eosio::multi_index<"counters"_n, usage_counter> counters_table;
+
+   // Recent throughput in one-hour buckets, kept in a ring of `hourly_slots` rows (one week) that are
+   // overwritten in place, so the table never grows past that. A bucket is reset when its hour comes around again.
+   static constexpr uint32_t hourly_slots = system_usage::hourly_slots;
+
+   struct [[eosio::table]] hourly_volume {
+      uint64_t slot;
+      uint32_t hour          = 0; // hours since epoch this bucket holds
+      int64_t  eos_to_xyz    = 0;
+      int64_t  xyz_to_eos    = 0;
+      uint64_t swaps         = 0;
+      uint64_t wrapped_calls = 0;
+
+      uint64_t primary_key() const { return slot; }
+   };
+
+   typedef eosio::multi_index<"hourly"_n, hourly_volume> hourly_table;
+
+   // Swaps queued with `queueswap` and executed later, in order, by `processq`.
+   // `processq` never handles more than `max_queue_batch` of them in one call.
+   static constexpr uint32_t max_queue_batch = 50;
+
+   struct [[eosio::table]] queued_swap {
+      uint64_t id;
+      name     account;
+      asset    quantity;
+
+      uint64_t primary_key() const { return id; }
+   };
+
+   typedef eosio::multi_index<"swapqueue"_n, queued_swap> swap_queue_table;
+
+   struct [[eosio::table]] queue_state {
+      uint64_t next_id = 0; // id given to the next queued swap
+      uint64_t cursor  = 0; // id of the next queued swap to process
+   };
+
+   typedef eosio::singleton<"queuestate"_n, queue_state> queue_state_table;
+
+   // A swap signed off-chain by `account` and submitted on its behalf by a relayer.
+   // The signature covers (chain id, this contract, account, quantity, nonce, expiry), and
+   // the symbol of `quantity` selects the direction of the swap.
+   struct signed_intent {
+      name                  account;
+      asset                 quantity;
+      uint64_t              nonce;
+      eosio::time_point_sec expiry;
+      eosio::signature      signature;
+   };
+
+   // One recipient of a `bulkcredit` batch.
+   struct bulk_credit {
+      name  account;
+      asset quantity;
+   };
+
+   // Position reached by each `bulkcredit` batch, so that a long list can be sent over many
+   // transactions and a chunk that was already applied is rejected instead of credited twice.
+   struct [[eosio::table]] bulk_cursor {
+      name     batch;
+      uint64_t next = 0; // offset of the next credit expected in this batch
+
+      uint64_t primary_key() const { return batch.value; }
+   };
+
+   typedef eosio::multi_index<"bulkcursor"_n, bulk_cursor> bulk_cursor_table;
+
+   // Result of `audit`. `outstanding` is the XYZ held outside of the reserve, which the EOS held by
+   // this contract must cover 1:1; `surplus` is the EOS left over once it does.
+   struct audit_result {
+      asset eos_balance;
+      asset supply;
+      asset reserve;
+      asset outstanding;
+      asset surplus;
+      bool  solvent;
+   };
+
    /**
     * Initialize the token with a maximum supply and given token ticker and store a ref to which ticker is selected.
     * This also issues the maximum supply to the system contract itself so that it can use it for
@@ -57,12 +243,38 @@ public:
     */
    [[eosio::action]] void init(asset maximum_supply);
 
+   system_contract(name s, name code, eosio::datastream<const char*> ds);
+   ~system_contract();
+
+   // Checks the reserve invariant from a single consistent view of the chain.
+   [[eosio::action, eosio::read_only]] audit_result audit();
+
+   // Credits many accounts from the reserve in one action; `offset` is the position of `credits` in the batch.
+   [[eosio::action]] void bulkcredit(const name& batch, uint64_t offset, const std::vector<bulk_credit>& credits);
+
+   // Upgrades up to `max_rows` rows of `config`, `stat` and `blocked` to their current layout, resuming where the
+   // previous call stopped. Balance rows can't be enumerated, they are upgraded when written or with `migrateaccts`.
+   //
+   // Upgraded rows keep their payer (`same_payer`), so RAM a new layout adds is billed to whoever pays for the row:
+   // this contract for `config`, `stat` and unreleased balance rows, but the owner for released balance rows and
+   // `blocked` rows. Billing an account that didn't authorize the action only works because this contract is
+   // privileged; a layout change that grows those rows bills their owners without asking them.
+   [[eosio::action]] void migrate(uint32_t max_rows);
+   [[eosio::action]] void migrateaccts(const std::vector<name>& owners);
+
+   // Seeds the holder and contract row counts of the `aggregates` table from an off-chain scan.
+   [[eosio::action]] void setaggr(uint64_t holders, uint64_t contract_rows);
+
    // ----------------------------------------------------
    // SYSTEM TOKEN ---------------------------------------
    // ----------------------------------------------------
-   [[eosio::action]] void transfer(const name& from, const name& to, const asset& quantity, const std::string& memo);
+   // `nonce` is optional; when it is set (and not 0) a second call with the same `from` and nonce is rejected.
+   [[eosio::action]] void transfer(const name& from, const name& to, const asset& quantity, const std::string& memo,
+                                   const eosio::binary_extension<uint64_t>& nonce);
    [[eosio::action]] void open(const name& owner, const symbol& symbol, const name& ram_payer);
    [[eosio::action]] void close(const name& owner, const symbol& symbol);
+   // Takes over the RAM of a balance row the contract paid for, which otherwise happens on its first debit.
+   [[eosio::action]] void release(const name& owner);
 
    // ----------------------------------------------------
    // SWAP -----------------------------------------------
@@ -73,11 +285,26 @@ public:
 
    // This action allows exchanges to support "swap & withdraw" for their users and have the swapped tokens flow
    // to the users instead of to their own hot wallets.
-   [[eosio::action]] void swapto(const name& from, const name& to, const asset& quantity, const std::string& memo);
+   [[eosio::action]] void swapto(const name& from, const name& to, const asset& quantity, const std::string& memo,
+                                 const eosio::binary_extension<uint64_t>& nonce);
    [[eosio::action]] void blockswapto(const name& account, const bool block);
+   // Swaps the whole balance an account holds of the given token to the other token.
+   [[eosio::action]] void swapall(const name& account, const symbol& symbol);
    [[eosio::action]] void enforcebal(const name& account, const asset& expected_eos_balance);
-   [[eosio::action]] void swapexcess(const name& account, const asset& eos_before);
+   [[eosio::action]] void swapexcess(const name& account, const asset& eos_before,
+                                     const eosio::binary_extension<name>& action);
    [[eosio::action]] void swaptrace(const name& account, const asset& quantity);
+   [[eosio::action]] void rexexcess(const name& account, const asset& eos_before, const name& action);
+   [[eosio::action]] void fundexcess(const name& account, const asset& fund_before, const name& action);
+
+   // Gasless swaps: accounts register a key, sign swap intents off-chain, and a relayer
+   // submits many of them in a single transaction that it pays for.
+   [[eosio::action]] void setrelaykey(const name& account, const eosio::public_key& key);
+   [[eosio::action]] void relayswaps(const std::vector<signed_intent>& intents);
+
+   // Bulk swaps: requests are appended to a FIFO queue and anyone can drain it in bounded batches.
+   [[eosio::action]] void queueswap(const name& account, const asset& quantity);
+   [[eosio::action]] void processq(uint32_t max_items);
 
    // ----------------------------------------------------
    // SYSTEM ACTIONS -------------------------------------
@@ -102,9 +329,13 @@ public:
    [[eosio::action]] void mvtosavings(const name& owner, const asset& rex);
    [[eosio::action]] void sellrex(const name& from, const asset& rex);
    [[eosio::action]] void withdraw(const name& owner, const asset& amount);
+   [[eosio::action]] void rexin(const name& owner, const asset& amount);
+   [[eosio::action]] void rexout(const name& owner, const asset& rex);
    [[eosio::action]] void newaccount(const name& creator, const name& name,
                                      const system_origin::authority& owner, const system_origin::authority& active);
    [[eosio::action]] void newaccount2(const name& creator, const name& name, eosio::public_key key);
+   [[eosio::action]] void createacct(const name& creator, const name& name, eosio::public_key key, uint32_t ram_bytes,
+                                     const asset& stake_net_quantity, const asset& stake_cpu_quantity);
    [[eosio::action]] void powerup(const name& payer, const name& receiver, uint32_t days, int64_t net_frac,
                                   int64_t cpu_frac, const asset& max_payment);
    [[eosio::action]] void delegatebw(const name& from, const name& receiver, const asset& stake_net_quantity,
@@ -116,7 +347,7 @@ public:
    [[eosio::action]] void unstaketorex(const name& owner, const name& receiver, const asset& from_net,
                                        const asset& from_cpu);
    [[eosio::action]] void refund(const name& owner);
-   [[eosio::action]] void claimrewards(const name owner);
+   [[eosio::action]] void claimrewards(const name owner, const eosio::binary_extension<bool>& restake);
    [[eosio::action]] void linkauth(name account, name code, name type, name requirement,
                                    eosio::binary_extension<name> authorized_by);
    [[eosio::action]] void unlinkauth(name account, name code, name type, eosio::binary_extension<name> authorized_by);
@@ -137,9 +368,11 @@ public:
    // ----------------------------------------------------
    // ACTION WRAPPERS ------------------------------------
    // ----------------------------------------------------
+   using audit_action        = eosio::action_wrapper<"audit"_n, &system_contract::audit>;
    using bidname_action      = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
    using bidrefund_action    = eosio::action_wrapper<"bidrefund"_n, &system_contract::bidrefund>;
    using blockswapto_action  = eosio::action_wrapper<"blockswapto"_n, &system_contract::blockswapto>;
+   using bulkcredit_action   = eosio::action_wrapper<"bulkcredit"_n, &system_contract::bulkcredit>;
    using buyram_action       = eosio::action_wrapper<"buyram"_n, &system_contract::buyram>;
    using buyramburn_action   = eosio::action_wrapper<"buyramburn"_n, &system_contract::buyramburn>;
    using buyrambytes_action  = eosio::action_wrapper<"buyrambytes"_n, &system_contract::buyrambytes>;
@@ -147,14 +380,18 @@ public:
    using buyrex_action       = eosio::action_wrapper<"buyrex"_n, &system_contract::buyrex>;
    using claimrewards_action = eosio::action_wrapper<"claimrewards"_n, &system_contract::claimrewards>;
    using close_action        = eosio::action_wrapper<"close"_n, &system_contract::close>;
+   using createacct_action   = eosio::action_wrapper<"createacct"_n, &system_contract::createacct>;
    using delegatebw_action   = eosio::action_wrapper<"delegatebw"_n, &system_contract::delegatebw>;
    using deleteauth_action   = eosio::action_wrapper<"deleteauth"_n, &system_contract::deleteauth>;
    using deposit_action      = eosio::action_wrapper<"deposit"_n, &system_contract::deposit>;
    using donatetorex_action  = eosio::action_wrapper<"donatetorex"_n, &system_contract::donatetorex>;
    using enforcebal_action   = eosio::action_wrapper<"enforcebal"_n, &system_contract::enforcebal>;
+   using fundexcess_action   = eosio::action_wrapper<"fundexcess"_n, &system_contract::fundexcess>;
    using giftram_action      = eosio::action_wrapper<"giftram"_n, &system_contract::giftram>;
    using init_action         = eosio::action_wrapper<"init"_n, &system_contract::init>;
    using linkauth_action     = eosio::action_wrapper<"linkauth"_n, &system_contract::linkauth>;
+   using migrate_action      = eosio::action_wrapper<"migrate"_n, &system_contract::migrate>;
+   using migrateaccts_action = eosio::action_wrapper<"migrateaccts"_n, &system_contract::migrateaccts>;
    using mvfrsavings_action  = eosio::action_wrapper<"mvfrsavings"_n, &system_contract::mvfrsavings>;
    using mvtosavings_action  = eosio::action_wrapper<"mvtosavings"_n, &system_contract::mvtosavings>;
    using newaccount2_action  = eosio::action_wrapper<"newaccount2"_n, &system_contract::newaccount2>;
@@ -162,13 +399,23 @@ public:
    using noop_action         = eosio::action_wrapper<"noop"_n, &system_contract::noop>;
    using open_action         = eosio::action_wrapper<"open"_n, &system_contract::open>;
    using powerup_action      = eosio::action_wrapper<"powerup"_n, &system_contract::powerup>;
+   using processq_action     = eosio::action_wrapper<"processq"_n, &system_contract::processq>;
+   using queueswap_action    = eosio::action_wrapper<"queueswap"_n, &system_contract::queueswap>;
    using ramburn_action      = eosio::action_wrapper<"ramburn"_n, &system_contract::ramburn>;
    using ramtransfer_action  = eosio::action_wrapper<"ramtransfer"_n, &system_contract::ramtransfer>;
    using refund_action       = eosio::action_wrapper<"refund"_n, &system_contract::refund>;
+   using relayswaps_action   = eosio::action_wrapper<"relayswaps"_n, &system_contract::relayswaps>;
+   using release_action      = eosio::action_wrapper<"release"_n, &system_contract::release>;
+   using rexexcess_action    = eosio::action_wrapper<"rexexcess"_n, &system_contract::rexexcess>;
+   using rexin_action        = eosio::action_wrapper<"rexin"_n, &system_contract::rexin>;
+   using rexout_action       = eosio::action_wrapper<"rexout"_n, &system_contract::rexout>;
    using sellram_action      = eosio::action_wrapper<"sellram"_n, &system_contract::sellram>;
    using sellrex_action      = eosio::action_wrapper<"sellrex"_n, &system_contract::sellrex>;
    using setabi_action       = eosio::action_wrapper<"setabi"_n, &system_contract::setabi>;
+   using setaggr_action      = eosio::action_wrapper<"setaggr"_n, &system_contract::setaggr>;
    using setcode_action      = eosio::action_wrapper<"setcode"_n, &system_contract::setcode>;
+   using setrelaykey_action  = eosio::action_wrapper<"setrelaykey"_n, &system_contract::setrelaykey>;
+   using swapall_action      = eosio::action_wrapper<"swapall"_n, &system_contract::swapall>;
    using swapexcess_action   = eosio::action_wrapper<"swapexcess"_n, &system_contract::swapexcess>;
    using swapto_action       = eosio::action_wrapper<"swapto"_n, &system_contract::swapto>;
    using swaptrace_action    = eosio::action_wrapper<"swaptrace"_n, &system_contract::swaptrace>;
@@ -183,12 +430,24 @@ public:
    using withdraw_action     = eosio::action_wrapper<"withdraw"_n, &system_contract::withdraw>;
 
 private:
-   void   add_balance(const name& owner, const asset& value, const name& ram_payer);
-   void   sub_balance(const name& owner, const asset& value);
-   symbol get_token_symbol();
-   void   enforce_symbol(const asset& quantity);
-   void   credit_eos_to(const name& account, const asset& quantity);
-   void   swap_before_forwarding(const name& account, const asset& quantity);
-   void   swap_after_forwarding(const name& account, const asset& quantity);
-   asset  get_eos_balance(const name& account);
+   aggregates_table  _aggregates_table;
+   token_aggregates  _aggregates;
+   bool              _aggregates_loaded = false;
+   bool              _aggregates_dirty  = false;
+
+   token_aggregates& get_aggregates(const symbol& sym);
+   void    add_balance(const name& owner, const asset& value, const name& ram_payer);
+   void    sub_balance(const name& owner, const asset& value);
+   void    release_balance(accounts& acnts, const account& row, const name& owner, const asset& balance);
+   symbol  get_token_symbol();
+   void    enforce_symbol(const asset& quantity);
+   void    credit_eos_to(const name& account, const asset& quantity);
+   void    swap_before_forwarding(const name& account, const asset& quantity, const name& action);
+   void    swap_after_forwarding(const name& account, const asset& quantity, const name& action);
+   void    count_usage(const name& action, const name& account, int64_t eos_to_xyz, int64_t xyz_to_eos);
+   asset   get_eos_balance(const name& account);
+   asset   get_rex_fund(const name& account);
+   bool    can_buy_rex(const name& account);
+   void    use_nonce(const name& account, const eosio::binary_extension<uint64_t>& nonce);
+   int64_t get_ram_cost(uint32_t bytes);
 };
@@ -15,4 +15,11 @@ namespace eosio_token {
         uint64_t primary_key()const { return balance.symbol.code().raw(); }
     };
     typedef eosio::multi_index< "accounts"_n, account > accounts;
+
+    // The `eosio.token` transfer signature, used to send EOS transfers inline now that
+    // this contract's own `transfer` action takes an extra nonce.
+    struct token {
+        void transfer(const name& from, const name& to, const asset& quantity, const std::string& memo);
+    };
+    using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
 }
\ No newline at end of file
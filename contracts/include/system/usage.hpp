@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Layout of the usage tables (`counters` and `hourly`, see system.entry.hpp). It doesn't depend on CDT, so the unit
+// tests, which read those tables row by row, include it too.
+namespace system_usage {
+   // rows per `counters` scope, so that busy actions don't share a single hot row
+   static constexpr uint64_t counter_shards = 4;
+   // one-hour rows in the `hourly` ring, one week
+   static constexpr uint32_t hourly_slots = 7 * 24;
+} // namespace system_usage
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <eosio/binary_extension.hpp>
+#include <eosio/serialize.hpp>
+
+#include <cstdint>
+
+// Versioned rows.
+//
+// A versioned row ends with an optional `version` byte. Rows written before the byte existed, or that never
+// needed an upgrade, don't carry it and are read as version 0, so making a table versioned doesn't change the
+// size of any of its rows. Each row type declares its `current_version`; when it is raised, the type also
+// implements `upgrade_from(uint8_t version)` to convert a row from `version` to `version + 1`.
+//
+// Rows are upgraded lazily whenever the contract writes them, and `migrate` upgrades the rest in the background.
+//
+// The `system_v1` test build (see contracts/CMakeLists.txt) defines SYSTEM_TEST_ROW_UPGRADE, which puts every row
+// type one version ahead of the real one with an `upgrade_from` that changes nothing, so that the tests exercise the
+// upgrade path even while every real version is 0 and that path is compiled out.
+#ifdef SYSTEM_TEST_ROW_UPGRADE
+#define SYSTEM_ROW_VERSION(v) ((v) + 1)
+#else
+#define SYSTEM_ROW_VERSION(v) (v)
+#endif
+
+namespace system_versioned {
+
+   template <typename Row>
+   uint8_t version_of(const Row& row) {
+      return row.version.has_value() ? row.version.value() : 0;
+   }
+
+   template <typename Row>
+   bool needs_upgrade(const Row& row) {
+      return version_of(row) < Row::current_version;
+   }
+
+   // Brings an existing row up to `Row::current_version`, one version at a time.
+   template <typename Row>
+   void upgrade(Row& row) {
+      if constexpr (Row::current_version > 0) {
+         for (uint8_t v = version_of(row); v < Row::current_version; ++v) {
+            row.upgrade_from(v);
+            row.version.emplace(v + 1);
+         }
+      }
+   }
+
+   // Marks a row that is created with the current layout.
+   template <typename Row>
+   void stamp(Row& row) {
+      if constexpr (Row::current_version > 0)
+         row.version.emplace(Row::current_version);
+   }
+
+   // Unlike the default `binary_extension` serialization, nothing is written for a row that has no version yet,
+   // or that is at version 0, which reads the same.
+   template <typename DataStream>
+   void pack_version(DataStream& ds, const eosio::binary_extension<uint8_t>& version) {
+      if (version.has_value() && version.value() > 0)
+         ds << version.value();
+   }
+
+} // namespace system_versioned
+
+// Same as EOSLIB_SERIALIZE, for a type that ends with a `binary_extension<uint8_t> version` not listed in MEMBERS.
+#define SYSTEM_VERSIONED_SERIALIZE(TYPE, MEMBERS)                                                                      \
+   template <typename DataStream>                                                                                      \
+   friend DataStream& operator<<(DataStream& ds, const TYPE& t) {                                                      \
+      ds BOOST_PP_SEQ_FOR_EACH(EOSLIB_REFLECT_MEMBER_OP, <<, MEMBERS);                                                 \
+      system_versioned::pack_version(ds, t.version);                                                                   \
+      return ds;                                                                                                       \
+   }                                                                                                                   \
+   template <typename DataStream>                                                                                      \
+   friend DataStream& operator>>(DataStream& ds, TYPE& t) {                                                            \
+      ds BOOST_PP_SEQ_FOR_EACH(EOSLIB_REFLECT_MEMBER_OP, >>, MEMBERS) >> t.version;                                    \
+      return ds;                                                                                                       \
+   }
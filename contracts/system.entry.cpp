@@ -4,9 +4,35 @@
 #include <system/token.hpp>
 #include <system/oldsystem.hpp>
 
+#include <algorithm>
+#include <map>
+
 using namespace eosio;
 using namespace system_origin;
 
+namespace {
+   // Upgrades the rows of `table` from primary key `next` on, visiting at most `budget` rows, at the expense of
+   // their payers (see `migrate`). Returns true once the end of the table is reached.
+   template <typename Table>
+   bool migrate_rows(Table& table, uint64_t& next, uint32_t& budget) {
+      auto itr = table.lower_bound(next);
+      for (; itr != table.end() && budget > 0; ++itr, --budget) {
+         if (system_versioned::needs_upgrade(*itr))
+            table.modify(itr, same_payer, [&](auto& row) { system_versioned::upgrade(row); });
+         next = itr->primary_key() + 1;
+      }
+      return itr == table.end();
+   }
+} // namespace
+
+system_contract::system_contract(name s, name code, datastream<const char*> ds)
+   : contract(s, code, ds), _aggregates_table(get_self(), get_self().value) {}
+
+system_contract::~system_contract() {
+   if (_aggregates_dirty)
+      _aggregates_table.set(_aggregates, get_self());
+}
+
 /**
  * Initialize the token with a maximum supply and given token ticker and store a ref to which ticker is selected.
  * This also issues the maximum supply to the system contract itself so that it can use it for
@@ -22,26 +48,147 @@ void system_contract::init(asset maximum_supply) {
    check(maximum_supply.is_valid(), "invalid supply");
    check(maximum_supply.amount > 0, "max-supply must be positive");
 
-   _config.set(config{.token_symbol = sym}, get_self());
+   config cfg{.token_symbol = sym};
+   system_versioned::stamp(cfg);
+   _config.set(cfg, get_self());
 
    stats statstable(get_self(), sym.code().raw());
    statstable.emplace(get_self(), [&](auto& s) {
       s.supply     = maximum_supply;
       s.max_supply = maximum_supply;
       s.issuer     = get_self();
+      system_versioned::stamp(s);
    });
 
    add_balance(get_self(), maximum_supply, get_self());
 }
 
+system_contract::audit_result system_contract::audit() {
+   symbol      sym = get_token_symbol();
+   stats       statstable(get_self(), sym.code().raw());
+   const auto& st = statstable.get(sym.code().raw(), "symbol does not exist");
+   accounts    acnts(get_self(), get_self().value);
+   const auto& reserve = acnts.get(sym.code().raw(), "no balance object found");
+
+   asset eos_balance = get_eos_balance(get_self());
+   asset outstanding = st.supply - reserve.balance;
+   asset surplus     = asset(eos_balance.amount - outstanding.amount, EOS);
+
+   return audit_result{
+      .eos_balance = eos_balance,
+      .supply      = st.supply,
+      .reserve     = reserve.balance,
+      .outstanding = outstanding,
+      .surplus     = surplus,
+      .solvent     = surplus.amount >= 0,
+   };
+}
+
+// Used to migrate legacy balances: the reserve is debited once for the whole chunk, and every recipient
+// row that does not exist yet is paid for by this contract until its owner releases it.
+void system_contract::bulkcredit(const name& batch, uint64_t offset, const std::vector<bulk_credit>& credits) {
+   require_auth(get_self());
+   check(!credits.empty(), "No credits");
+
+   bulk_cursor_table _cursors(get_self(), get_self().value);
+   auto              cursor = _cursors.find(batch.value);
+   uint64_t          next   = cursor == _cursors.end() ? 0 : cursor->next;
+   check(offset == next, "Expected offset " + std::to_string(next) + " for this batch");
+
+   const symbol token_symbol = get_token_symbol();
+   asset        total(0, token_symbol);
+   for (const auto& credit : credits) {
+      check(credit.quantity.symbol == token_symbol, "Invalid symbol");
+      check(credit.quantity.amount > 0, "must credit positive quantity");
+      check(credit.account != get_self(), "cannot credit the reserve");
+      check(is_account(credit.account), "account does not exist: " + credit.account.to_string());
+      total += credit.quantity;
+   }
+
+   sub_balance(get_self(), total);
+   for (const auto& credit : credits) {
+      add_balance(credit.account, credit.quantity, get_self());
+   }
+
+   if (cursor == _cursors.end()) {
+      _cursors.emplace(get_self(), [&](auto& c) {
+         c.batch = batch;
+         c.next  = credits.size();
+      });
+   } else {
+      _cursors.modify(cursor, same_payer, [&](auto& c) { c.next += credits.size(); });
+   }
+}
+
+void system_contract::migrate(uint32_t max_rows) {
+   require_auth(get_self());
+   check(max_rows > 0, "max_rows must be greater than 0");
+
+   migrate_state_table _state(get_self(), get_self().value);
+   migrate_state       state  = _state.get_or_default();
+   uint32_t            budget = max_rows;
+
+   if (state.stage == uint8_t(migrate_stage::config)) {
+      config_table _config(get_self(), get_self().value);
+      if (_config.exists()) {
+         config cfg = _config.get();
+         if (system_versioned::needs_upgrade(cfg)) {
+            system_versioned::upgrade(cfg);
+            _config.set(cfg, get_self());
+         }
+      }
+      --budget;
+      state = migrate_state{.stage = uint8_t(migrate_stage::stat)};
+   }
+   if (state.stage == uint8_t(migrate_stage::stat) && budget > 0) {
+      stats statstable(get_self(), get_token_symbol().code().raw());
+      if (migrate_rows(statstable, state.next, budget))
+         state = migrate_state{.stage = uint8_t(migrate_stage::blocked)};
+   }
+   if (state.stage == uint8_t(migrate_stage::blocked) && budget > 0) {
+      blocked_table _blocked(get_self(), get_self().value);
+      if (migrate_rows(_blocked, state.next, budget))
+         state = migrate_state{.stage = uint8_t(migrate_stage::done)};
+   }
+
+   // a finished pass leaves no state behind, so the next call starts a new one
+   if (state.stage == uint8_t(migrate_stage::done)) {
+      _state.remove();
+   } else {
+      _state.set(state, get_self());
+   }
+}
+
+// The owners of released rows pay for what the upgrade adds without authorizing it, see `migrate`.
+void system_contract::migrateaccts(const std::vector<name>& owners) {
+   require_auth(get_self());
+   const uint64_t sym_code_raw = get_token_symbol().code().raw();
+   for (const auto& owner : owners) {
+      accounts acnts(get_self(), owner.value);
+      auto     itr = acnts.find(sym_code_raw);
+      if (itr != acnts.end() && system_versioned::needs_upgrade(*itr))
+         acnts.modify(itr, same_payer, [&](auto& a) { system_versioned::upgrade(a); });
+   }
+}
+
+void system_contract::setaggr(uint64_t holders, uint64_t contract_rows) {
+   require_auth(get_self());
+   auto& aggregates              = get_aggregates(get_token_symbol());
+   aggregates.holders            = holders;
+   aggregates.contract_rows      = contract_rows;
+   aggregates.contract_ram_bytes = contract_rows * account_row_bytes;
+}
+
 
 // ----------------------------------------------------
 // SYSTEM TOKEN ---------------------------------------
 // ----------------------------------------------------
 
-void system_contract::transfer(const name& from, const name& to, const asset& quantity, const std::string& memo) {
+void system_contract::transfer(const name& from, const name& to, const asset& quantity, const std::string& memo,
+                               const binary_extension<uint64_t>& nonce) {
    check(from != to, "cannot transfer to self");
    require_auth(from);
+   use_nonce(from, nonce);
    check(is_account(to), "to account does not exist");
 
    auto        sym = quantity.symbol.code();
@@ -65,6 +212,7 @@ void system_contract::transfer(const name& from, const name& to, const asset& qu
    // they are swapping from XYZ to EOS
    if (to == get_self()) {
       check(quantity.symbol == get_token_symbol(), "Wrong token used");
+      count_usage("transfer"_n, from, 0, quantity.amount);
       credit_eos_to(from, quantity);
    }
 }
@@ -85,7 +233,10 @@ void system_contract::open(const name& owner, const symbol& symbol, const name&
       acnts.emplace(ram_payer, [&](auto& a) {
          a.balance = asset{0, symbol};
          a.released = ram_payer == owner;
+         system_versioned::stamp(a);
       });
+      if (ram_payer != owner)
+         get_aggregates(symbol).sponsored_rows += 1;
    }
 }
 
@@ -95,19 +246,77 @@ void system_contract::close(const name& owner, const symbol& symbol) {
    auto     it = acnts.find(symbol.code().raw());
    check(it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect.");
    check(it->balance.amount == 0, "Cannot close because the balance is not zero.");
+   if (!it->released) {
+      auto& aggregates = get_aggregates(symbol);
+      aggregates.sponsored_rows -= std::min<uint64_t>(aggregates.sponsored_rows, 1);
+   }
    acnts.erase(it);
 }
 
+// Hands an unreleased row over to its owner, who pays for its RAM from then on.
+// The row is erased and emplaced again instead of being modified with a new payer: a payer change
+// only moves the row itself, while erasing the last row of the scope also refunds the scope overhead.
+void system_contract::release_balance(accounts& acnts, const account& row, const name& owner, const asset& balance) {
+   auto& aggregates = get_aggregates(balance.symbol);
+   if (row.balance.amount == 0) {
+      aggregates.sponsored_rows -= std::min<uint64_t>(aggregates.sponsored_rows, 1);
+   } else {
+      aggregates.contract_rows -= std::min<uint64_t>(aggregates.contract_rows, 1);
+      aggregates.contract_ram_bytes -= std::min(aggregates.contract_ram_bytes, account_row_bytes);
+   }
+
+   account moved = row;
+   system_versioned::upgrade(moved);
+   moved.balance  = balance;
+   moved.released = true;
+
+   acnts.erase(row);
+   acnts.emplace(owner, [&](auto& a) { a = moved; });
+}
+
+void system_contract::release(const name& owner) {
+   require_auth(owner);
+   accounts    acnts(get_self(), owner.value);
+   const auto& row = acnts.get(get_token_symbol().code().raw(), "no balance object found");
+   check(!row.released, "Balance row is already released");
+   release_balance(acnts, row, owner, row.balance);
+}
+
 void system_contract::add_balance(const name& owner, const asset& value, const name& ram_payer) {
+   auto& aggregates = get_aggregates(value.symbol);
+   if (owner == get_self())
+      aggregates.circulating -= value;
+
    accounts to_acnts(get_self(), owner.value);
    auto     to = to_acnts.find(value.symbol.code().raw());
    if (to == to_acnts.end()) {
+      // A contract-paid row only ever starts with a positive balance, and `sub_balance` hands it to its
+      // owner on the first debit, so the contract never pays for a row that has drained to zero.
+      check(value.amount > 0 || ram_payer == owner, "cannot credit an empty balance");
       to_acnts.emplace(ram_payer == owner ? owner : get_self(), [&](auto& a) {
          a.balance = value;
          a.released = ram_payer == owner;
+         system_versioned::stamp(a);
       });
+      if (ram_payer != owner) {
+         aggregates.contract_rows += 1;
+         aggregates.contract_ram_bytes += account_row_bytes;
+      }
+      if (owner != get_self() && value.amount > 0)
+         aggregates.holders += 1;
    } else {
-      to_acnts.modify(to, same_payer, [&](auto& a) { a.balance += value; });
+      if (owner != get_self() && to->balance.amount == 0 && value.amount > 0)
+         aggregates.holders += 1;
+      // the first credit of a row `open` created on behalf of its owner
+      if (!to->released && to->balance.amount == 0 && value.amount > 0) {
+         aggregates.sponsored_rows -= std::min<uint64_t>(aggregates.sponsored_rows, 1);
+         aggregates.contract_rows += 1;
+         aggregates.contract_ram_bytes += account_row_bytes;
+      }
+      to_acnts.modify(to, same_payer, [&](auto& a) {
+         system_versioned::upgrade(a);
+         a.balance += value;
+      });
    }
 }
 
@@ -117,16 +326,17 @@ void system_contract::sub_balance(const name& owner, const asset& value) {
    const auto& from = from_acnts.get(value.symbol.code().raw(), "no balance object found");
    check(from.balance.amount >= value.amount, "overdrawn balance");
 
-   if(!from.released){
-      auto balance = from.balance;
-      // This clears out the RAM consumed by the scope overhead.
-      from_acnts.erase( from );
-      from_acnts.emplace( owner, [&]( auto& a ){
-         a.balance = balance - value;
-         a.released = true;
-      });
+   auto& aggregates = get_aggregates(value.symbol);
+   if (owner == get_self())
+      aggregates.circulating += value;
+   else if (from.balance.amount > 0 && from.balance.amount == value.amount)
+      aggregates.holders -= std::min<uint64_t>(aggregates.holders, 1);
+
+   if (!from.released) {
+      release_balance(from_acnts, from, owner, from.balance - value);
    } else {
       from_acnts.modify( from, owner, [&]( auto& a ) {
+         system_versioned::upgrade(a);
          a.balance -= value;
       });
    }
@@ -151,8 +361,10 @@ void system_contract::on_transfer(const name& from, const name& to, const asset&
       return;
 
    check(quantity.symbol == EOS, "Invalid symbol");
+   count_usage("transfer"_n, from, quantity.amount, 0);
    asset swap_amount = asset(quantity.amount, get_token_symbol());
-   transfer_action(get_self(), {{get_self(), "active"_n}}).send(get_self(), from, swap_amount, std::cref(memo));
+   transfer_action(get_self(), {{get_self(), "active"_n}}).
+      send(get_self(), from, swap_amount, std::cref(memo), binary_extension<uint64_t>{});
 }
 
 // Allows an account to block themselves from being a recipient of the `swapto` action.
@@ -166,7 +378,10 @@ void system_contract::blockswapto(const name& account, const bool block) {
    auto          itr = _blocked.find(account.value);
    if (block) {
       if (itr == _blocked.end()) {
-         _blocked.emplace(account, [&](auto& b) { b.account = account; });
+         _blocked.emplace(account, [&](auto& b) {
+            b.account = account;
+            system_versioned::stamp(b);
+         });
       }
    } else {
       if (itr != _blocked.end()) {
@@ -178,8 +393,10 @@ void system_contract::blockswapto(const name& account, const bool block) {
 
 // This action allows exchanges to support "swap & withdraw" for their users and have the swapped tokens flow
 // to the users instead of to their own hot wallets.
-void system_contract::swapto(const name& from, const name& to, const asset& quantity, const std::string& memo) {
+void system_contract::swapto(const name& from, const name& to, const asset& quantity, const std::string& memo,
+                             const binary_extension<uint64_t>& nonce) {
    require_auth(from);
+   use_nonce(from, nonce);
 
    blocked_table _blocked(get_self(), get_self().value);
    auto          itr = _blocked.find(to.value);
@@ -187,21 +404,154 @@ void system_contract::swapto(const name& from, const name& to, const asset& quan
 
    if (quantity.symbol == EOS) {
       // First swap the EOS to XYZ and credit it to the user
-      transfer_action("eosio.token"_n, {{from, "active"_n}}).send(from, get_self(), quantity, std::cref(memo));
+      eosio_token::transfer_action("eosio.token"_n, {{from, "active"_n}}).send(from, get_self(), quantity, std::cref(memo));
 
       // Then transfer the swapped XYZ to the target account
-      transfer_action(get_self(), {{from, "active"_n}}).send(from, to, asset(quantity.amount, get_token_symbol()), std::cref(memo));
+      transfer_action(get_self(), {{from, "active"_n}}).
+         send(from, to, asset(quantity.amount, get_token_symbol()), std::cref(memo), binary_extension<uint64_t>{});
    } else if (quantity.symbol == get_token_symbol()) {
       // First swap the XYZ to EOS and credit it to the user
-      transfer_action(get_self(), {{from, "active"_n}}).send(from, get_self(), quantity, std::cref(memo));
+      transfer_action(get_self(), {{from, "active"_n}}).
+         send(from, get_self(), quantity, std::cref(memo), binary_extension<uint64_t>{});
 
       // Then transfer the swapped EOS to the target account
-      transfer_action("eosio.token"_n, {{from, "active"_n}}).send(from, to, asset(quantity.amount, EOS), std::cref(memo));
+      eosio_token::transfer_action("eosio.token"_n, {{from, "active"_n}}).send(from, to, asset(quantity.amount, EOS), std::cref(memo));
+   } else {
+      check(false, "Invalid symbol");
+   }
+}
+
+// Swaps an account's entire balance of one token to the other. The balance is read inside the action,
+// so the swapped amount can never be stale, even with transfers landing in the same block.
+void system_contract::swapall(const name& account, const symbol& symbol) {
+   require_auth(account);
+
+   if (symbol == EOS) {
+      asset balance = get_eos_balance(account);
+      check(balance.amount > 0, "Nothing to swap");
+      swap_after_forwarding(account, balance, "swapall"_n);
+   } else if (symbol == get_token_symbol()) {
+      accounts    acnts(get_self(), account.value);
+      const auto& found = acnts.get(symbol.code().raw(), "no balance object found");
+      check(found.balance.amount > 0, "Nothing to swap");
+      swap_before_forwarding(account, found.balance, "swapall"_n);
    } else {
       check(false, "Invalid symbol");
    }
 }
 
+// Registers (or rotates) the key an account uses to sign swap intents for `relayswaps`.
+void system_contract::setrelaykey(const name& account, const public_key& key) {
+   require_auth(account);
+
+   relay_table _relay(get_self(), get_self().value);
+   auto        itr = _relay.find(account.value);
+   if (itr == _relay.end()) {
+      _relay.emplace(account, [&](auto& r) {
+         r.account = account;
+         r.key     = key;
+      });
+   } else {
+      _relay.modify(itr, account, [&](auto& r) { r.key = key; });
+   }
+}
+
+// Executes a batch of swaps signed off-chain by their owners. The relayer that submits the
+// transaction pays for the CPU, so owners only need to hold the token they are swapping.
+// Each intent must be signed with the owner's registered key for this chain, must not be expired,
+// and must use a nonce greater than the last one executed for that owner.
+void system_contract::relayswaps(const std::vector<signed_intent>& intents) {
+   check(!intents.empty(), "No intents to relay");
+
+   relay_table          _relay(get_self(), get_self().value);
+   const symbol         token_symbol = get_token_symbol();
+   const time_point_sec now(current_time_point());
+
+   for (const auto& intent : intents) {
+      check(intent.expiry > now, "Intent expired");
+      check(intent.quantity.symbol == EOS || intent.quantity.symbol == token_symbol, "Invalid symbol");
+
+      const auto& relay = _relay.get(intent.account.value, "No relay key registered for account");
+      check(intent.nonce > relay.nonce, "Intent nonce already used");
+
+      const auto data = pack(
+         std::make_tuple(get_chain_id(), get_self(), intent.account, intent.quantity, intent.nonce, intent.expiry));
+      const checksum256 digest = sha256(data.data(), data.size());
+      check(recover_key(digest, intent.signature) == relay.key, "Invalid intent signature");
+
+      _relay.modify(relay, same_payer, [&](auto& r) { r.nonce = intent.nonce; });
+
+      if (intent.quantity.symbol == EOS) {
+         swap_after_forwarding(intent.account, intent.quantity, "relayswaps"_n);
+      } else {
+         swap_before_forwarding(intent.account, intent.quantity, "relayswaps"_n);
+      }
+   }
+}
+
+// Queues a swap of `quantity` for `account`, to be executed later by `processq`.
+// The account pays for the queue row until it is processed.
+void system_contract::queueswap(const name& account, const asset& quantity) {
+   require_auth(account);
+   check(quantity.is_valid(), "invalid quantity");
+   check(quantity.amount > 0, "Swap amount must be greater than 0");
+   check(quantity.symbol == EOS || quantity.symbol == get_token_symbol(), "Invalid symbol");
+
+   queue_state_table _state(get_self(), get_self().value);
+   auto              state = _state.get_or_default();
+
+   swap_queue_table _queue(get_self(), get_self().value);
+   _queue.emplace(account, [&](auto& q) {
+      q.id       = state.next_id;
+      q.account  = account;
+      q.quantity = quantity;
+   });
+
+   state.next_id++;
+   _state.set(state, get_self());
+}
+
+// Executes up to `max_items` queued swaps in FIFO order, starting at the persisted cursor.
+// Anyone can call this. Swaps the account can no longer cover are dropped instead of
+// failing the batch, so one bad request can never block the queue.
+void system_contract::processq(uint32_t max_items) {
+   check(max_items > 0, "max_items must be greater than 0");
+   max_items = std::min(max_items, max_queue_batch);
+
+   queue_state_table _state(get_self(), get_self().value);
+   auto              state = _state.get_or_default();
+
+   swap_queue_table _queue(get_self(), get_self().value);
+   auto             itr = _queue.lower_bound(state.cursor);
+   check(itr != _queue.end(), "Nothing to process");
+
+   // EOS is only debited once the inline transfers run, so track what this batch already spent.
+   std::map<name, int64_t> eos_spent;
+   const symbol            token_symbol = get_token_symbol();
+
+   for (uint32_t processed = 0; processed < max_items && itr != _queue.end(); ++processed) {
+      const name  account  = itr->account;
+      const asset quantity = itr->quantity;
+      state.cursor         = itr->id + 1;
+      itr                  = _queue.erase(itr);
+
+      if (quantity.symbol == EOS) {
+         int64_t& spent = eos_spent[account];
+         if (get_eos_balance(account).amount - spent >= quantity.amount) {
+            spent += quantity.amount;
+            swap_after_forwarding(account, quantity, "processq"_n);
+         }
+      } else if (quantity.symbol == token_symbol) {
+         accounts acnts(get_self(), account.value);
+         auto     found = acnts.find(token_symbol.code().raw());
+         if (found != acnts.end() && found->balance.amount >= quantity.amount) {
+            swap_before_forwarding(account, quantity, "processq"_n);
+         }
+      }
+   }
+
+   _state.set(state, get_self());
+}
 
 
 // ----------------------------------------------------
@@ -217,6 +567,25 @@ symbol system_contract::get_token_symbol() {
    return cfg.token_symbol;
 }
 
+// Loads the `aggregates` singleton once per action; the destructor writes it back if it was touched.
+// The first time it is used, circulating supply is derived from the `stat` row and this contract's balance.
+system_contract::token_aggregates& system_contract::get_aggregates(const symbol& sym) {
+   if (!_aggregates_loaded) {
+      if (_aggregates_table.exists()) {
+         _aggregates = _aggregates_table.get();
+      } else {
+         stats       statstable(get_self(), sym.code().raw());
+         const auto& st = statstable.get(sym.code().raw(), "symbol does not exist");
+         accounts    self_acnts(get_self(), get_self().value);
+         auto        self = self_acnts.find(sym.code().raw());
+         _aggregates.circulating = st.supply - (self == self_acnts.end() ? asset{0, sym} : self->balance);
+      }
+      _aggregates_loaded = true;
+   }
+   _aggregates_dirty = true;
+   return _aggregates;
+}
+
 // Enforces that the given asset has the right token symbol (XYZ)
 void system_contract::enforce_symbol(const asset& quantity) {
    check(quantity.symbol == get_token_symbol(), "Wrong token used");
@@ -228,14 +597,15 @@ void system_contract::credit_eos_to(const name& account, const asset& quantity)
    check(quantity.amount > 0, "Credit amount must be greater than 0");
 
    asset swap_amount = asset(quantity.amount, EOS);
-   transfer_action("eosio.token"_n, {{get_self(), "active"_n}}).send(get_self(), account, swap_amount, std::string(""));
+   eosio_token::transfer_action("eosio.token"_n, {{get_self(), "active"_n}}).send(get_self(), account, swap_amount, std::string(""));
 }
 
 // Allows users to use XYZ tokens to perform actions on the system contract
 // by swapping them for EOS tokens before forwarding the action
-void system_contract::swap_before_forwarding(const name& account, const asset& quantity) {
+void system_contract::swap_before_forwarding(const name& account, const asset& quantity, const name& action) {
    check(quantity.symbol == get_token_symbol(), "Wrong token used");
    check(quantity.amount > 0, "Swap before amount must be greater than 0");
+   count_usage(action, account, 0, quantity.amount);
 
    swaptrace_action(get_self(), {{get_self(), "active"_n}}).send(account, quantity);
    sub_balance(account, quantity);
@@ -244,12 +614,16 @@ void system_contract::swap_before_forwarding(const name& account, const asset& q
 }
 
 // Allows users to get back XYZ tokens from actions that give them EOS tokens
-// by swapping them for XYZ as the last inline action
-void system_contract::swap_after_forwarding(const name& account, const asset& quantity) {
+// by swapping them for XYZ as the last inline action.
+// The swapped amount is counted by `on_transfer` when the EOS arrives, so only the call is counted
+// here, and not even that when `action` is empty (for callers that count their own calls).
+void system_contract::swap_after_forwarding(const name& account, const asset& quantity, const name& action) {
    asset swap_amount = asset(quantity.amount, EOS);
    check(swap_amount.amount > 0, "Swap after amount must be greater than 0");
+   if (action != name{})
+      count_usage(action, account, 0, 0);
 
-   transfer_action("eosio.token"_n, {{account, "active"_n}}).send(account, get_self(), swap_amount, std::string(""));
+   eosio_token::transfer_action("eosio.token"_n, {{account, "active"_n}}).send(account, get_self(), swap_amount, std::string(""));
 }
 
 // Gets a given account's balance of EOS
@@ -263,6 +637,116 @@ asset system_contract::get_eos_balance(const name& account) {
    return found->balance;
 }
 
+// Gets a given account's EOS balance in the REX fund
+asset system_contract::get_rex_fund(const name& account) {
+   rex_fund_table rexfund("eosio"_n, "eosio"_n.value);
+   const auto&    found = rexfund.find(account.value);
+   if (found == rexfund.end()) {
+      return asset(0, EOS);
+   }
+
+   return found->balance;
+}
+
+// Whether `eosio::buyrex` would accept the account: it must vote for a proxy or for at least 21 producers
+bool system_contract::can_buy_rex(const name& account) {
+   voters_table voters("eosio"_n, "eosio"_n.value);
+   auto         itr = voters.find(account.value);
+   return itr != voters.end() && (itr->proxy != name{} || itr->producers.size() >= 21);
+}
+
+// Records a client nonce for `transfer` and `swapto` so that a retried request fails instead of executing twice.
+// Calls without a nonce (or with a nonce of 0, which is what inline transfers carry) are not tracked.
+// Every tracked call also erases a few expired nonces, which keeps the table bounded.
+void system_contract::use_nonce(const name& account, const binary_extension<uint64_t>& nonce) {
+   if (!nonce.has_value() || nonce.value() == 0)
+      return;
+
+   nonces_table         _nonces(get_self(), get_self().value);
+   const time_point_sec now(current_time_point());
+
+   auto by_expiry = _nonces.get_index<"byexpiry"_n>();
+   auto expired   = by_expiry.begin();
+   for (uint32_t i = 0; i < nonce_gc_per_call && expired != by_expiry.end() && expired->expires <= now; ++i) {
+      expired = by_expiry.erase(expired);
+   }
+
+   auto by_nonce = _nonces.get_index<"byacctnonce"_n>();
+   auto itr      = by_nonce.find((uint128_t(account.value) << 64) | nonce.value());
+   if (itr != by_nonce.end()) {
+      check(itr->expires <= now, "Nonce already used, this request was already executed");
+      // expired but not collected yet, so it can be reused in place
+      by_nonce.modify(itr, account, [&](auto& n) { n.expires = now + nonce_ttl_sec; });
+      return;
+   }
+
+   _nonces.emplace(account, [&](auto& n) {
+      n.id      = _nonces.available_primary_key();
+      n.account = account;
+      n.nonce   = nonce.value();
+      n.expires = now + nonce_ttl_sec;
+   });
+}
+
+// Gets the EOS cost (including the RAM fee) of buying a number of bytes,
+// using the same bancor pricing the system contract uses for `buyrambytes`.
+int64_t system_contract::get_ram_cost(uint32_t bytes) {
+   rammarket     _rammarket("eosio"_n, "eosio"_n.value);
+   auto          itr         = _rammarket.find(RAMCORE.raw());
+   const int64_t ram_reserve = itr->base.balance.amount;
+   const int64_t eos_reserve = itr->quote.balance.amount;
+   const int64_t cost        = get_bancor_input(ram_reserve, eos_reserve, bytes);
+   return cost / double(0.995);
+}
+
+// Records a call to `action` in the usage counters and the hourly ring buffer.
+void system_contract::count_usage(const name& action, const name& account, int64_t eos_to_xyz, int64_t xyz_to_eos) {
+   counters_table _counters(get_self(), action.value);
+   // the low bits of most names are zero, so mix them before picking a shard
+   uint64_t shard = ((account.value * 0x9E3779B97F4A7C15ull) >> 32) % counter_shards;
+   auto     itr   = _counters.find(shard);
+   if (itr == _counters.end()) {
+      _counters.emplace(get_self(), [&](auto& c) {
+         c.shard      = shard;
+         c.calls      = 1;
+         c.eos_to_xyz = eos_to_xyz;
+         c.xyz_to_eos = xyz_to_eos;
+      });
+   } else {
+      _counters.modify(itr, same_payer, [&](auto& c) {
+         c.calls += 1;
+         c.eos_to_xyz += eos_to_xyz;
+         c.xyz_to_eos += xyz_to_eos;
+      });
+   }
+
+   // and the hourly ring buffer
+   hourly_table _hourly(get_self(), get_self().value);
+   uint32_t     hour   = current_time_point().sec_since_epoch() / 3600;
+   bool         swap   = eos_to_xyz != 0 || xyz_to_eos != 0;
+   bool         wrap   = action != "transfer"_n;
+   auto         bucket = _hourly.find(hour % hourly_slots);
+   if (bucket == _hourly.end()) {
+      _hourly.emplace(get_self(), [&](auto& h) {
+         h.slot          = hour % hourly_slots;
+         h.hour          = hour;
+         h.eos_to_xyz    = eos_to_xyz;
+         h.xyz_to_eos    = xyz_to_eos;
+         h.swaps         = swap;
+         h.wrapped_calls = wrap;
+      });
+   } else {
+      _hourly.modify(bucket, same_payer, [&](auto& h) {
+         if (h.hour != hour)
+            h = hourly_volume{.slot = h.slot, .hour = hour};
+         h.eos_to_xyz += eos_to_xyz;
+         h.xyz_to_eos += xyz_to_eos;
+         h.swaps += swap;
+         h.wrapped_calls += wrap;
+      });
+   }
+}
+
 // Makes sure that an EOS balance is what it should be after an action.
 // This is to prevent unexpected inline changes to their balances during the
 // forwarding of actions to the system contracts.
@@ -276,12 +760,16 @@ void system_contract::enforcebal(const name& account, const asset& expected_eos_
 }
 
 // Swaps any excess EOS back to XYZ after an action
-void system_contract::swapexcess(const name& account, const asset& eos_before) {
+// `action` is the wrapper that requested the swap; it is left empty when that call was already counted.
+void system_contract::swapexcess(const name& account, const asset& eos_before, const binary_extension<name>& action) {
    require_auth(get_self());
+   if (action.has_value())
+      count_usage(action.value(), account, 0, 0);
+
    asset eos_after = get_eos_balance(account);
    if (eos_after > eos_before) {
       asset excess = eos_after - eos_before;
-      swap_after_forwarding(account, excess);
+      swap_after_forwarding(account, excess, name{});
    }
 }
 
@@ -289,6 +777,34 @@ void system_contract::swaptrace(const name& account, const asset& quantity) {
    require_auth(get_self());
 }
 
+// Deposits any excess EOS into REX and buys REX with it after an action,
+// instead of swapping it back to XYZ like `swapexcess` does.
+// `action` is the wrapper that requested it, and the call is counted under that name.
+void system_contract::rexexcess(const name& account, const asset& eos_before, const name& action) {
+   require_auth(get_self());
+   count_usage(action, account, 0, 0);
+   asset eos_after = get_eos_balance(account);
+   if (eos_after > eos_before) {
+      asset excess = eos_after - eos_before;
+      deposit_action("eosio"_n, {{account, "active"_n}}).send(account, excess);
+      buyrex_action("eosio"_n, {{account, "active"_n}}).send(account, excess);
+   }
+}
+
+// Withdraws any EOS that was added to the REX fund during an action
+// and swaps it back to XYZ.
+// `action` is the wrapper that requested it, and the call is counted under that name.
+void system_contract::fundexcess(const name& account, const asset& fund_before, const name& action) {
+   require_auth(get_self());
+   count_usage(action, account, 0, 0);
+   asset fund_after = get_rex_fund(account);
+   if (fund_after > fund_before) {
+      asset excess = fund_after - fund_before;
+      withdraw_action("eosio"_n, {{account, "active"_n}}).send(account, excess);
+      swap_after_forwarding(account, excess, name{});
+   }
+}
+
 // ----------------------------------------------------
 // SYSTEM ACTIONS -------------------------------------
 // ----------------------------------------------------
@@ -299,7 +815,7 @@ void system_contract::swaptrace(const name& account, const asset& quantity) {
 
 void system_contract::bidname(const name& bidder, const name& newname, const asset& bid) {
    require_auth(bidder);
-   swap_before_forwarding(bidder, bid);
+   swap_before_forwarding(bidder, bid, "bidname"_n);
 
    bidname_action("eosio"_n, {{bidder, "active"_n}}).send(bidder, newname, asset(bid.amount, EOS));
 }
@@ -309,31 +825,25 @@ void system_contract::bidrefund(const name& bidder, const name& newname) {
    auto eos_balance = get_eos_balance(bidder);
 
    bidrefund_action("eosio"_n, {{bidder, "active"_n}}).send(bidder, newname);
-   swapexcess_action(get_self(), {{get_self(), "active"_n}}).send(bidder, eos_balance);
+   swapexcess_action(get_self(), {{get_self(), "active"_n}}).
+      send(bidder, eos_balance, binary_extension<name>("bidrefund"_n));
 }
 
 void system_contract::buyram(const name& payer, const name& receiver, const asset& quant) {
    require_auth(payer);
-   swap_before_forwarding(payer, quant);
+   swap_before_forwarding(payer, quant, "buyram"_n);
    buyram_action("eosio"_n, {{payer, "active"_n}}).send(payer, receiver, asset(quant.amount, EOS));
 }
 
 void system_contract::buyramburn(const name& payer, const asset& quantity, const std::string& memo) {
    require_auth(payer);
-   swap_before_forwarding(payer, quantity);
+   swap_before_forwarding(payer, quantity, "buyramburn"_n);
    buyramburn_action("eosio"_n, {{payer, "active"_n}}).send(payer, asset(quantity.amount, EOS), std::cref(memo));
 }
 
 void system_contract::buyrambytes(name payer, name receiver, uint32_t bytes) {
    require_auth(payer);
-   rammarket     _rammarket("eosio"_n, "eosio"_n.value);
-   auto          itr           = _rammarket.find(RAMCORE.raw());
-   const int64_t ram_reserve   = itr->base.balance.amount;
-   const int64_t eos_reserve   = itr->quote.balance.amount;
-   const int64_t cost          = get_bancor_input(ram_reserve, eos_reserve, bytes);
-   const int64_t cost_plus_fee = cost / double(0.995);
-
-   swap_before_forwarding(payer, asset(cost_plus_fee, get_token_symbol()));
+   swap_before_forwarding(payer, asset(get_ram_cost(bytes), get_token_symbol()), "buyrambytes"_n);
 
    buyrambytes_action("eosio"_n, {{payer, "active"_n}}).send(payer, receiver, bytes);
 
@@ -344,7 +854,7 @@ void system_contract::buyrambytes(name payer, name receiver, uint32_t bytes) {
 
 void system_contract::buyramself(const name& payer, const asset& quant) {
    require_auth(payer);
-   swap_before_forwarding(payer, quant);
+   swap_before_forwarding(payer, quant, "buyramself"_n);
    buyramself_action("eosio"_n, {{payer, "active"_n}}).send(payer, asset(quant.amount, EOS));
 }
 
@@ -363,12 +873,13 @@ void system_contract::sellram(const name& account, const int64_t& bytes) {
    asset eos_before = get_eos_balance(account);
 
    sellram_action("eosio"_n, {{account, "active"_n}}).send(account, bytes);
-   swapexcess_action(get_self(), {{get_self(), "active"_n}}).send(account, eos_before);
+   swapexcess_action(get_self(), {{get_self(), "active"_n}}).
+      send(account, eos_before, binary_extension<name>("sellram"_n));
 }
 
 void system_contract::deposit(const name& owner, const asset& amount) {
    require_auth(owner);
-   swap_before_forwarding(owner, amount);
+   swap_before_forwarding(owner, amount, "deposit"_n);
    deposit_action("eosio"_n, {{owner, "active"_n}}).send(owner, asset(amount.amount, EOS));
 }
 
@@ -400,7 +911,27 @@ void system_contract::withdraw(const name& owner, const asset& amount) {
 
    withdraw_action("eosio"_n, {{owner, "active"_n}}).send(owner, asset(amount.amount, EOS));
 
-   swap_after_forwarding(owner, asset(amount.amount, EOS));
+   swap_after_forwarding(owner, asset(amount.amount, EOS), "withdraw"_n);
+}
+
+// Single action REX entry: swaps XYZ to EOS once, then deposits it and buys REX with the exact same amount.
+void system_contract::rexin(const name& owner, const asset& amount) {
+   require_auth(owner);
+   swap_before_forwarding(owner, amount, "rexin"_n);
+
+   asset eos_amount = asset(amount.amount, EOS);
+   deposit_action("eosio"_n, {{owner, "active"_n}}).send(owner, eos_amount);
+   buyrex_action("eosio"_n, {{owner, "active"_n}}).send(owner, eos_amount);
+}
+
+// Single action REX exit: sells REX, then withdraws exactly what the sale added to the REX fund
+// and swaps it back to XYZ.
+void system_contract::rexout(const name& owner, const asset& rex) {
+   require_auth(owner);
+   auto fund_before = get_rex_fund(owner);
+
+   sellrex_action("eosio"_n, {{owner, "active"_n}}).send(owner, rex);
+   fundexcess_action(get_self(), {{get_self(), "active"_n}}).send(owner, fund_before, "rexout"_n);
 }
 
 void system_contract::newaccount(const name& creator, const name& name, const authority& owner,
@@ -417,6 +948,38 @@ void system_contract::newaccount2(const name& creator, const name& name, eosio::
    newaccount_action("eosio"_n, {{creator, "active"_n}}).send(creator, name, auth, auth);
 }
 
+// Account factory: creates an account from a single public key, buys it `ram_bytes` of RAM and stakes
+// it NET and CPU, with the whole cost paid in XYZ through one aggregated swap instead of one per action.
+void system_contract::createacct(const name& creator, const name& name, eosio::public_key key, uint32_t ram_bytes,
+                                 const asset& stake_net_quantity, const asset& stake_cpu_quantity) {
+   require_auth(creator);
+   const symbol token_symbol = get_token_symbol();
+   check(stake_net_quantity.symbol == token_symbol, "Wrong token used");
+   check(stake_cpu_quantity.symbol == token_symbol, "Wrong token used");
+   check(stake_net_quantity.amount >= 0 && stake_cpu_quantity.amount >= 0, "must stake a non-negative amount");
+
+   const asset stake    = stake_net_quantity + stake_cpu_quantity;
+   check(ram_bytes > 0 || stake.amount > 0, "must buy RAM or stake a positive amount");
+   const asset ram_cost = asset(ram_bytes > 0 ? get_ram_cost(ram_bytes) : 0, token_symbol);
+   swap_before_forwarding(creator, ram_cost + stake, "createacct"_n);
+
+   authority auth{.threshold = 1, .keys = {{.key = key, .weight = 1}}};
+   newaccount_action("eosio"_n, {{creator, "active"_n}}).send(creator, name, auth, auth);
+
+   if (ram_bytes > 0) {
+      buyrambytes_action("eosio"_n, {{creator, "active"_n}}).send(creator, name, ram_bytes);
+   }
+
+   if (stake.amount > 0) {
+      delegatebw_action("eosio"_n, {{creator, "active"_n}}).
+         send(creator, name, asset(stake_net_quantity.amount, EOS), asset(stake_cpu_quantity.amount, EOS), false);
+   }
+
+   // The creator's balance should not have changed from the amount it was before
+   // any swaps took place, exactly like `buyrambytes`.
+   enforcebal_action(get_self(), {{creator, "active"_n}}).send(creator, get_eos_balance(creator));
+}
+
 void system_contract::powerup(const name& payer, const name& receiver, uint32_t days, int64_t net_frac,
                               int64_t cpu_frac, const asset& max_payment) {
    require_auth(payer);
@@ -424,18 +987,19 @@ void system_contract::powerup(const name& payer, const name& receiver, uint32_t
    // otherwise this contract would have to replicate a large portion of the powerup code which is unnecessary
    asset eos_balance_before_swap = get_eos_balance(payer);
 
-   swap_before_forwarding(payer, max_payment);
+   swap_before_forwarding(payer, max_payment, "powerup"_n);
    asset eos_payment = asset(max_payment.amount, EOS);
    powerup_action("eosio"_n, {{payer, "active"_n}}).send(payer, receiver, days, net_frac, cpu_frac, eos_payment);
 
-   // swap excess back to XYZ
-   swapexcess_action(get_self(), {{get_self(), "active"_n}}).send(payer, eos_balance_before_swap);
+   // swap excess back to XYZ, the call itself was already counted by `swap_before_forwarding`
+   swapexcess_action(get_self(), {{get_self(), "active"_n}}).
+      send(payer, eos_balance_before_swap, binary_extension<name>{});
 }
 
 void system_contract::delegatebw(const name& from, const name& receiver, const asset& stake_net_quantity,
                                  const asset& stake_cpu_quantity, const bool& transfer) {
    require_auth(from);
-   swap_before_forwarding(from, stake_net_quantity + stake_cpu_quantity);
+   swap_before_forwarding(from, stake_net_quantity + stake_cpu_quantity, "delegatebw"_n);
 
    delegatebw_action("eosio"_n, {{from, "active"_n}}).
       send(from, receiver, asset(stake_net_quantity.amount, EOS), asset(stake_cpu_quantity.amount, EOS), transfer);
@@ -477,16 +1041,27 @@ void system_contract::refund(const name& owner) {
 
    refund_action("eosio"_n, {{owner, "active"_n}}).send(owner);
 
-   swapexcess_action(get_self(), {{get_self(), "active"_n}}).send(owner, eos_balance);
+   swapexcess_action(get_self(), {{get_self(), "active"_n}}).
+      send(owner, eos_balance, binary_extension<name>("refund"_n));
 }
 
-void system_contract::claimrewards(const name owner) {
+// When `restake` is set, the claimed rewards are compounded into REX directly
+// instead of being swapped to XYZ and later swapped back to EOS to buy REX.
+void system_contract::claimrewards(const name owner, const binary_extension<bool>& restake) {
    require_auth(owner);
    auto eos_balance = get_eos_balance(owner);
 
-   claimrewards_action("eosio"_n, {{owner, "active"_n}}).send(owner);
+   // `eosio::claimrewards` only takes the owner, so the `restake` extension is not forwarded.
+   action(permission_level{owner, "active"_n}, "eosio"_n, "claimrewards"_n, std::make_tuple(owner)).send();
 
-   swapexcess_action(get_self(), {{get_self(), "active"_n}}).send(owner, eos_balance);
+   // REX only takes voters, and a failing `buyrex` would undo the claim too, so the rewards of an account that
+   // can't buy REX are swapped to XYZ like without `restake`
+   if (restake.has_value() && restake.value() && can_buy_rex(owner)) {
+      rexexcess_action(get_self(), {{get_self(), "active"_n}}).send(owner, eos_balance, "claimrewards"_n);
+   } else {
+      swapexcess_action(get_self(), {{get_self(), "active"_n}}).
+         send(owner, eos_balance, binary_extension<name>("claimrewards"_n));
+   }
 }
 
 void system_contract::linkauth(name account, name code, name type, name requirement,
@@ -525,7 +1100,7 @@ void system_contract::setcode(const name& account, uint8_t vmtype, uint8_t vmver
 
 void system_contract::donatetorex(const name& payer, const asset& quantity, const std::string& memo) {
    require_auth(payer);
-   swap_before_forwarding(payer, quantity);
+   swap_before_forwarding(payer, quantity, "donatetorex"_n);
    donatetorex_action("eosio"_n, {{payer, "active"_n}}).send(payer, asset(quantity.amount, EOS), std::cref(memo));
 }
 
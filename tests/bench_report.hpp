@@ -0,0 +1,137 @@
+#pragma once
+
+#include <eosio/chain/trace.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <fc/io/json.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace eosio_system {
+
+// What one transaction cost, as recorded in its trace.
+struct bench_sample {
+   std::string label;
+   int64_t     elapsed_us     = 0; // wall clock time spent executing the transaction
+   int64_t     billed_cpu_us  = 0; // CPU billed to the payer
+   uint64_t    net_bytes      = 0; // NET billed to the payer
+   uint32_t    inline_actions = 0; // actions executed on top of the pushed ones, notifications excluded
+   int64_t     ram_delta      = 0; // sum of the RAM deltas of all accounts
+};
+
+inline bench_sample make_bench_sample(const std::string& label, const eosio::chain::transaction_trace_ptr& trace,
+                                      size_t pushed_actions = 1) {
+   bench_sample s{.label = label, .elapsed_us = trace->elapsed.count(), .net_bytes = trace->net_usage};
+   if (trace->receipt)
+      s.billed_cpu_us = trace->receipt->cpu_usage_us;
+
+   uint32_t executed = 0;
+   for (const auto& at : trace->action_traces) {
+      if (at.receiver == at.act.account)
+         ++executed;
+      for (const auto& d : at.account_ram_deltas)
+         s.ram_delta += d.delta;
+   }
+   s.inline_actions = executed - pushed_actions;
+   return s;
+}
+
+// Average of several runs of the same transaction.
+inline bench_sample average_samples(const std::string& label, const std::vector<bench_sample>& runs) {
+   bench_sample avg{.label = label};
+   if (runs.empty())
+      return avg;
+   for (const auto& s : runs) {
+      avg.elapsed_us += s.elapsed_us;
+      avg.billed_cpu_us += s.billed_cpu_us;
+      avg.net_bytes += s.net_bytes;
+      avg.inline_actions += s.inline_actions;
+      avg.ram_delta += s.ram_delta;
+   }
+   avg.elapsed_us /= int64_t(runs.size());
+   avg.billed_cpu_us /= int64_t(runs.size());
+   avg.net_bytes /= runs.size();
+   avg.inline_actions /= runs.size();
+   avg.ram_delta /= int64_t(runs.size());
+   return avg;
+}
+
+// Collects samples, writes them as a JSON report and compares them with a stored baseline.
+//
+// Environment:
+//   XYZ_BENCH_REPORT        where to write the report (default: xyz_bench_report.json)
+//   XYZ_BENCH_BASELINE      report to compare with (default: the one committed next to the suite, see
+//                           XYZ_BENCH_DEFAULT_BASELINE); no comparison is made when set to an empty string
+//   XYZ_BENCH_CPU_PCT       allowed billed CPU increase over the baseline, in percent (default: 25)
+//   XYZ_BENCH_NET_BYTES     allowed NET increase over the baseline, in bytes (default: 0)
+//   XYZ_BENCH_RAM_BYTES     allowed RAM increase over the baseline, in bytes (default: 0)
+class bench_report {
+public:
+   void add(bench_sample s) { _samples.push_back(std::move(s)); }
+
+   const std::vector<bench_sample>& samples() const { return _samples; }
+
+   void write() const {
+      const char* path = std::getenv("XYZ_BENCH_REPORT");
+      fc::json::save_to_file(fc::variant(_samples), path ? path : "xyz_bench_report.json", true);
+   }
+
+   // The report `check_baseline` compares with, empty when there is none.
+   static std::string baseline_path() {
+      if (const char* path = std::getenv("XYZ_BENCH_BASELINE"))
+         return path;
+#ifdef XYZ_BENCH_DEFAULT_BASELINE
+      return XYZ_BENCH_DEFAULT_BASELINE;
+#else
+      return {};
+#endif
+   }
+
+   // Fails the running test case for every sample that got more expensive than the baseline allows.
+   void check_baseline() const {
+      const auto path = baseline_path();
+      if (path.empty())
+         return;
+
+      std::map<std::string, bench_sample> baseline;
+      for (auto& s : fc::json::from_file(path).as<std::vector<bench_sample>>())
+         baseline[s.label] = s;
+
+      const int64_t cpu_pct   = env_or("XYZ_BENCH_CPU_PCT", 25);
+      const int64_t net_bytes = env_or("XYZ_BENCH_NET_BYTES", 0);
+      const int64_t ram_bytes = env_or("XYZ_BENCH_RAM_BYTES", 0);
+
+      for (const auto& s : _samples) {
+         auto it = baseline.find(s.label);
+         if (it == baseline.end()) {
+            BOOST_TEST_MESSAGE(s.label << ": not in the baseline " << path << ", not checked");
+            continue; // new action, nothing to compare with
+         }
+         const auto& b = it->second;
+         BOOST_CHECK_MESSAGE(s.billed_cpu_us * 100 <= b.billed_cpu_us * (100 + cpu_pct),
+                             s.label << ": billed CPU " << s.billed_cpu_us << "us, baseline " << b.billed_cpu_us << "us");
+         BOOST_CHECK_MESSAGE(int64_t(s.net_bytes) <= int64_t(b.net_bytes) + net_bytes,
+                             s.label << ": NET " << s.net_bytes << " bytes, baseline " << b.net_bytes << " bytes");
+         BOOST_CHECK_MESSAGE(s.ram_delta <= b.ram_delta + ram_bytes,
+                             s.label << ": RAM " << s.ram_delta << " bytes, baseline " << b.ram_delta << " bytes");
+         BOOST_CHECK_MESSAGE(s.inline_actions <= b.inline_actions,
+                             s.label << ": " << s.inline_actions << " inline actions, baseline " << b.inline_actions);
+      }
+   }
+
+private:
+   static int64_t env_or(const char* var, int64_t def) {
+      const char* v = std::getenv(var);
+      return v ? std::strtoll(v, nullptr, 10) : def;
+   }
+
+   std::vector<bench_sample> _samples;
+};
+
+} // namespace eosio_system
+
+FC_REFLECT(eosio_system::bench_sample, (label)(elapsed_us)(billed_cpu_us)(net_bytes)(inline_actions)(ram_delta))
@@ -2,13 +2,19 @@
 
 #include "contracts.hpp"
 #include "test_symbol.hpp"
+#include "xyz_raw.hpp"
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/snapshot.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/variant_object.hpp>
+#include <system/usage.hpp>
+#include <cstdlib>
 #include <fstream>
+#include <optional>
 #include <ranges>
+#include <sstream>
 
 
 using namespace eosio::chain;
@@ -17,9 +23,42 @@ using namespace fc;
 
 using mvo = fc::mutable_variant_object;
 
+inline constexpr int64_t powerup_frac  = 1'000'000'000'000'000ll; // 1.0 = 10^15
+inline constexpr int64_t stake_weight = 100'000'000'0000ll; // 10^12
+
+struct powerup_config_resource {
+   std::optional<int64_t>        current_weight_ratio = {};
+   std::optional<int64_t>        target_weight_ratio  = {};
+   std::optional<int64_t>        assumed_stake_weight = {};
+   std::optional<time_point_sec> target_timestamp     = {};
+   std::optional<double>         exponent             = {};
+   std::optional<uint32_t>       decay_secs           = {};
+   std::optional<asset>          min_price            = {};
+   std::optional<asset>          max_price            = {};
+};
+FC_REFLECT(powerup_config_resource,                                                             //
+           (current_weight_ratio)(target_weight_ratio)(assumed_stake_weight)(target_timestamp) //
+           (exponent)(decay_secs)(min_price)(max_price))
+
+struct powerup_config {
+   powerup_config_resource net             = {};
+   powerup_config_resource cpu             = {};
+   std::optional<uint32_t> powerup_days    = {};
+   std::optional<asset>    min_powerup_fee = {};
+};
+FC_REFLECT(powerup_config, (net)(cpu)(powerup_days)(min_powerup_fee))
+
 namespace eosio_system {
 
-class eosio_system_tester : public validating_tester {
+// The unit tests replay every block on a second, validating node. Benchmark and load test executables define
+// XYZ_FAST_TESTER to run on a single node, so that their numbers reflect the work of one node.
+#ifdef XYZ_FAST_TESTER
+using system_tester_base = tester;
+#else
+using system_tester_base = validating_tester;
+#endif
+
+class eosio_system_tester : public system_tester_base {
 public:
    // -----------------
    // static utilities
@@ -35,7 +74,9 @@ public:
    static symbol eos_symbol() { return symbol{CORE_SYM}; }
 
    ~eosio_system_tester() {
+#ifndef XYZ_FAST_TESTER
       skip_validate = true;
+#endif
    }
 
    // -----------------
@@ -102,6 +143,26 @@ public:
          return push_action(_contract_name, act, std::move(params), {from});
       }
 
+      action_result transfer(name from, name to, const asset& amount, uint64_t nonce) { // xyz contract only
+         auto act    = "transfer"_n;
+         auto params = serialize(_tester.xyz_abi_ser, act,
+                                 mvo()("from", from)("to", to)("quantity", amount)("memo", "")("nonce", nonce));
+         return push_action(from, act, std::move(params), {from});
+      }
+
+      action_result swapto(name from, name to, const asset& amount, uint64_t nonce) {
+         auto act    = "swapto"_n;
+         auto params = serialize(_tester.xyz_abi_ser, act,
+                                 mvo()("from", from)("to", to)("quantity", amount)("memo", "")("nonce", nonce));
+         return push_action(_contract_name, act, std::move(params), {from});
+      }
+
+      action_result swapall(name account, const symbol& sym) { // this action available only on xyz contract
+         auto act    = "swapall"_n;
+         auto params = serialize(_tester.xyz_abi_ser, act, mvo()("account", account)("symbol", sym));
+         return push_action(_contract_name, act, std::move(params), {account});
+      }
+
       action_result bidname(name bidder, name newname, const asset& bid) {
          auto act    = "bidname"_n;
          auto params = serialize(_tester.xyz_abi_ser, act, mvo()("bidder", bidder)("newname", newname)("bid", bid));
@@ -174,6 +235,18 @@ public:
          return push_action(_contract_name, act, std::move(params), {from});
       }
 
+      action_result rexin(name owner, const asset& amount) {
+         auto act    = "rexin"_n;
+         auto params = serialize(_tester.xyz_abi_ser, act, mvo()("owner", owner)("amount", amount));
+         return push_action(_contract_name, act, std::move(params), {owner});
+      }
+
+      action_result rexout(name owner, const asset& rex) {
+         auto act    = "rexout"_n;
+         auto params = serialize(_tester.xyz_abi_ser, act, mvo()("owner", owner)("rex", rex));
+         return push_action(_contract_name, act, std::move(params), {owner});
+      }
+
       action_result mvtosavings(name owner, const asset& rex) {
          auto act    = "mvtosavings"_n;
          auto params = serialize(_tester.xyz_abi_ser, act, mvo()("owner", owner)("rex", rex));
@@ -216,6 +289,15 @@ public:
          return push_action(_contract_name, act, std::move(params), {owner});
       }
 
+      action_result createacct(name creator, name newname, const public_key_type& key, uint32_t ram_bytes,
+                               const asset& stake_net_quantity, const asset& stake_cpu_quantity) {
+         auto act    = "createacct"_n;
+         auto params = serialize(_tester.xyz_abi_ser, act,
+                                 mvo()("creator", creator)("name", newname)("key", key)("ram_bytes", ram_bytes)(
+                                    "stake_net_quantity", stake_net_quantity)("stake_cpu_quantity", stake_cpu_quantity));
+         return push_action(_contract_name, act, std::move(params), {creator});
+      }
+
       account_name         _contract_name;
       eosio_system_tester& _tester;
    };
@@ -237,10 +319,51 @@ public:
       return token_abi_ser.binary_to_variant("account", data, abi_serializer_max_time)["balance"].as<asset>();
    }
 
+   // Same as `get_balance`, unpacking the row with fc::raw instead of the ABI.
+   asset get_balance_raw(name code, account_name act, symbol token) const {
+      vector<char> data = get_row_by_account(code, act, "accounts"_n, account_name(token.to_symbol_code().value));
+      return data.empty() ? asset(0, token) : fc::raw::unpack<xyz_raw::token_account>(data).balance;
+   }
+
    asset get_eos_balance(account_name act) const { return get_balance("eosio.token"_n, act, eos_symbol()); }
 
    asset get_xyz_balance(account_name act) const { return get_balance(xyz_name, act, xyz_symbol()); }
 
+   // usage counters of an action, summed over all shards
+   fc::mutable_variant_object get_usage(name action) const {
+      uint64_t calls = 0;
+      int64_t  eos_to_xyz = 0, xyz_to_eos = 0;
+      for (uint64_t shard = 0; shard < system_usage::counter_shards; ++shard) {
+         vector<char> data = get_row_by_account(xyz_name, action, "counters"_n, name(shard));
+         if (data.empty())
+            continue;
+         auto row = xyz_abi_ser.binary_to_variant("usage_counter", data, abi_serializer_max_time);
+         calls += row["calls"].as<uint64_t>();
+         eos_to_xyz += row["eos_to_xyz"].as<int64_t>();
+         xyz_to_eos += row["xyz_to_eos"].as<int64_t>();
+      }
+      return mvo()("calls", calls)("eos_to_xyz", eos_to_xyz)("xyz_to_eos", xyz_to_eos);
+   }
+
+   // hourly bucket that an action pushed in the pending block writes to
+   fc::variant get_current_hourly() const {
+      uint32_t     hour = control->pending_block_time().sec_since_epoch() / 3600;
+      vector<char> data = get_row_by_account(xyz_name, xyz_name, "hourly"_n, name(hour % system_usage::hourly_slots));
+      return data.empty() ? fc::variant() : xyz_abi_ser.binary_to_variant("hourly_volume", data, abi_serializer_max_time);
+   }
+
+   // runs the read-only `audit` action and decodes its return value
+   fc::variant audit_xyz(account_name caller) {
+      auto trace = base_tester::push_action(xyz_name, "audit"_n, caller, mvo());
+      produce_block();
+      return xyz_abi_ser.binary_to_variant("audit_result", trace->action_traces[0].return_value, abi_serializer_max_time);
+   }
+
+   fc::variant get_xyz_aggregates() const {
+      vector<char> data = get_row_by_account(xyz_name, xyz_name, "aggregates"_n, "aggregates"_n);
+      return data.empty() ? fc::variant() : xyz_abi_ser.binary_to_variant("token_aggregates", data, abi_serializer_max_time);
+   }
+
    bool check_balances(account_name act, const vector<asset>& assets) const {
       for (const auto& a : assets) {
          if (a.get_symbol() == xyz_symbol()) {
@@ -287,12 +410,87 @@ public:
       ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
    }
 
+   // The first tester deploys the contracts and saves a snapshot of the resulting chain; the following ones restore
+   // that snapshot instead of deploying again. Set XYZ_TESTER_SNAPSHOT=0 to always deploy.
    eosio_system_tester()
-      : validating_tester({}, nullptr, setup_policy::full)
+#ifdef XYZ_FAST_TESTER
+      : system_tester_base(genesis_snapshot ? setup_policy::none : setup_policy::full)
+#else
+      : system_tester_base({}, nullptr, genesis_snapshot ? setup_policy::none : setup_policy::full)
+#endif
       , eosio_token("eosio.token"_n, *this)
       , eosio_xyz(xyz_name, *this)
       , eosio("eosio"_n, *this) {
+      if (genesis_snapshot) {
+         restore_snapshot(*genesis_snapshot);
+         return;
+      }
+      deploy_contracts();
+      if (snapshots_enabled()) {
+         produce_block();
+         control->abort_block();
+         genesis_snapshot = take_snapshot();
+      }
+   }
 
+   // Same setup on a chain whose controller config is first edited by `conf_edit`, e.g. to give a large test more
+   // chain state. `tempdir` holds the chain and must outlive the tester.
+   template <typename Lambda>
+   eosio_system_tester(const fc::temp_directory& tempdir, Lambda conf_edit)
+      : system_tester_base(tempdir, conf_edit)
+      , eosio_token("eosio.token"_n, *this)
+      , eosio_xyz(xyz_name, *this)
+      , eosio("eosio"_n, *this) {
+      execute_setup_policy(setup_policy::full);
+      deploy_contracts();
+   }
+
+   inline static std::optional<std::string> genesis_snapshot;
+
+   static bool snapshots_enabled() {
+      const char* v = std::getenv("XYZ_TESTER_SNAPSHOT");
+      return !v || std::string(v) != "0";
+   }
+
+   std::string take_snapshot() {
+      std::ostringstream out;
+      auto               writer = std::make_shared<ostream_snapshot_writer>(out);
+      control->write_snapshot(writer);
+      writer->finalize();
+      return out.str();
+   }
+
+   // Replaces the chain of the node, and of the validating node, with the one in `snapshot`. Each node starts over in
+   // new directories, as the ones it was opened with already hold a chain.
+   void restore_snapshot(const std::string& snapshot) {
+      auto restored_dir = [](const std::filesystem::path& dir) {
+         return dir.parent_path() / ("snapshot_" + dir.filename().string());
+      };
+
+      auto cfg       = get_config();
+      cfg.blocks_dir = restored_dir(cfg.blocks_dir);
+      cfg.state_dir  = restored_dir(cfg.state_dir);
+      close();
+      std::istringstream in(snapshot);
+      init(cfg, std::make_shared<istream_snapshot_reader>(in));
+
+#ifndef XYZ_FAST_TESTER
+      validating_node.reset();
+      vcfg.blocks_dir = restored_dir(vcfg.blocks_dir);
+      vcfg.state_dir  = restored_dir(vcfg.state_dir);
+      std::istringstream vin(snapshot);
+      validating_node = std::make_unique<controller>(vcfg, make_protocol_feature_set(), control->get_chain_id());
+      validating_node->add_indices();
+      validating_node->startup([]() {}, []() { return false; }, std::make_shared<istream_snapshot_reader>(vin));
+#endif
+
+      create_serializer("eosio.token"_n, token_abi_ser);
+      create_serializer("eosio.bpay"_n, bpay_abi_ser);
+      create_serializer(config::system_account_name, abi_ser);
+      create_serializer(xyz_name, xyz_abi_ser);
+   }
+
+   void deploy_contracts() {
       // -------- create accounts -----------------------------------------------------------------
       produce_block();
       create_accounts({"eosio.token"_n, "eosio.ram"_n, "eosio.ramfee"_n, "eosio.stake"_n, "eosio.bpay"_n,
@@ -350,6 +548,91 @@ public:
          create_account_with_resources(a, creator);
    }
 
+   // Bulk version of `create_accounts_with_resources`, for tests that need thousands of accounts: accounts are named
+   // `prefix` followed by a 5 character counter, created `per_trx` at a time by `eosio` with the same RAM and stake
+   // as `create_account_with_resources`, and optionally funded with `funds` EOS.
+   vector<account_name> create_accounts_bulk(const std::string& prefix, uint32_t count, asset funds = eos("0.0000"),
+                                             uint32_t per_trx = 20, uint32_t ram_bytes = 8000) {
+      FC_ASSERT(prefix.size() <= 7, "prefix leaves no room for the counter");
+      static constexpr std::string_view digits = "12345abcdefghijklmnopqrstuvwxyz";
+
+      const account_name       creator = config::system_account_name;
+      const auto               perms   = vector<permission_level>{ {creator, config::active_name} };
+      vector<account_name>     created;
+      created.reserve(count);
+
+      for (uint32_t first = 0; first < count; first += per_trx) {
+         signed_transaction trx;
+         for (uint32_t i = first; i < std::min(count, first + per_trx); ++i) {
+            std::string n = prefix;
+            for (uint32_t v = i, d = 0; d < 5; ++d, v /= digits.size())
+               n += digits[v % digits.size()];
+            account_name a(n);
+            created.push_back(a);
+
+            trx.actions.emplace_back(perms, newaccount{.creator = creator,
+                                                       .name    = a,
+                                                       .owner   = authority(get_public_key(a, "owner")),
+                                                       .active  = authority(get_public_key(a, "active"))});
+            trx.actions.push_back(xyz_raw::make_action(creator, perms, xyz_raw::buyrambytes{creator, a, ram_bytes}));
+            trx.actions.push_back(xyz_raw::make_action(
+               creator, perms, xyz_raw::delegatebw{creator, a, eos("10.0000"), eos("10.0000"), false}));
+            if (funds.get_amount() > 0)
+               trx.actions.push_back(
+                  xyz_raw::make_action("eosio.token"_n, perms, xyz_raw::transfer{creator, a, funds, ""}));
+         }
+         set_transaction_headers(trx);
+         trx.sign(get_private_key(creator, "active"), control->get_chain_id());
+         push_transaction(trx);
+         produce_block();
+      }
+      return created;
+   }
+
+   // Pushes `actions` in one transaction signed with the active key of each of their authorizers. The action data is
+   // already packed (see xyz_raw.hpp), so unlike `push_action` nothing goes through the ABI.
+   transaction_trace_ptr push_raw(vector<action> actions, uint32_t billed_cpu_time_us = DEFAULT_BILLED_CPU_TIME_US) {
+      signed_transaction trx;
+      trx.actions = std::move(actions);
+      set_transaction_headers(trx);
+
+      flat_set<account_name> signers;
+      for (const auto& a : trx.actions)
+         for (const auto& auth : a.authorization)
+            signers.insert(auth.actor);
+      for (auto signer : signers)
+         trx.sign(get_private_key(signer, "active"), control->get_chain_id());
+      return push_transaction(trx, fc::time_point::maximum(), billed_cpu_time_us);
+   }
+
+   void configure_powerup(const asset& min_price = asset::from_string("0.0000 EOS"),
+                          const asset& min_fee   = asset::from_string("1.0000 EOS")) {
+      powerup_config config;
+
+      config.net.current_weight_ratio = powerup_frac / 4;
+      config.net.target_weight_ratio  = powerup_frac / 100;
+      config.net.assumed_stake_weight = stake_weight;
+      config.net.target_timestamp     = time_point_sec(control->pending_block_time() + fc::days(100));
+      config.net.exponent             = 2;
+      config.net.decay_secs           = fc::days(1).to_seconds();
+      config.net.min_price            = min_price;
+      config.net.max_price            = asset::from_string("1000000.0000 EOS");
+
+      config.cpu.current_weight_ratio = powerup_frac / 4;
+      config.cpu.target_weight_ratio  = powerup_frac / 100;
+      config.cpu.assumed_stake_weight = stake_weight;
+      config.cpu.target_timestamp     = time_point_sec(control->pending_block_time() + fc::days(100));
+      config.cpu.exponent             = 2;
+      config.cpu.decay_secs           = fc::days(1).to_seconds();
+      config.cpu.min_price            = min_price;
+      config.cpu.max_price            = asset::from_string("1000000.0000 EOS");
+
+      config.powerup_days    = 30;
+      config.min_powerup_fee = min_fee;
+
+      base_tester::push_action(eos_name, "cfgpowerup"_n, eos_name, mvo()("args", config));
+   }
+
    transaction_trace_ptr create_account_with_resources(account_name a, account_name creator, uint32_t ram_bytes = 8000,
                                                        uint32_t gifted_ram_bytes = 0) {
       signed_transaction trx;
@@ -655,6 +938,23 @@ public:
       return push_transaction(trx);
    }
 
+   // Builds a swap intent for `relayswaps`, signed off-chain with the account's active key
+   // over the same (chain id, contract, account, quantity, nonce, expiry) tuple the contract verifies.
+   // `chain_id` defaults to the tester's chain
+   fc::variant signed_swap_intent(account_name account, const asset& quantity, uint64_t nonce, time_point_sec expiry,
+                                  std::optional<chain_id_type> chain_id = {}) {
+      fc::sha256::encoder enc;
+      fc::raw::pack(enc, chain_id ? *chain_id : control->get_chain_id());
+      fc::raw::pack(enc, xyz_name);
+      fc::raw::pack(enc, account);
+      fc::raw::pack(enc, quantity);
+      fc::raw::pack(enc, nonce);
+      fc::raw::pack(enc, expiry);
+      auto signature = get_private_key(account, "active").sign(enc.result());
+
+      return mvo()("account", account)("quantity", quantity)("nonce", nonce)("expiry", expiry)("signature", signature);
+   }
+
    action_result push_action(const account_name& signer, const action_name& name, const variant_object& data) {
       string action_type_name = abi_ser.get_action_type(name);
 
@@ -1401,7 +1701,7 @@ public:
       produce_block();
       produce_block(fc::seconds(1000));
 
-      auto trace_auth = validating_tester::push_action(config::system_account_name, updateauth::get_name(), config::system_account_name, mvo()
+      auto trace_auth = system_tester_base::push_action(config::system_account_name, updateauth::get_name(), config::system_account_name, mvo()
                                             ("account", name(config::system_account_name).to_string())
                                             ("permission", name(config::active_name).to_string())
                                             ("parent", name(config::owner_name).to_string())
@@ -1531,6 +1831,18 @@ public:
    abi_serializer xyz_abi_ser; // xyz wrap contract
 };
 
+// Holds the chain of a `configured_system_tester`; a base class so that it is constructed before the tester.
+struct tester_chain_dir {
+   fc::temp_directory chain_dir;
+};
+
+// An `eosio_system_tester` on a chain whose controller config is first edited by `conf_edit`, e.g. to change the
+// state size or the wasm runtime.
+struct configured_system_tester : tester_chain_dir, eosio_system_tester {
+   explicit configured_system_tester(const std::function<void(controller::config&)>& conf_edit)
+      : eosio_system_tester(chain_dir, conf_edit) {}
+};
+
 inline fc::mutable_variant_object voter(account_name acct) {
    return mutable_variant_object()("owner", acct)("proxy", name(0).to_string())("producers", variants())("staked",
                                                                                                          int64_t(0))
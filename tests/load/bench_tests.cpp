@@ -0,0 +1,275 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include "contracts.hpp"
+
+#include "bench_report.hpp"
+#include "eosio.system_tester.hpp"
+#include "scenario_runner.hpp"
+
+#include <cstdlib>
+
+using namespace eosio_system;
+
+namespace {
+
+const account_name alice    = "alice"_n;
+const account_name bob      = "bob"_n;
+const account_name carol    = "carol"_n;
+const account_name code     = "benchcode"_n;    // `setcode` and `setabi` target
+const account_name producer = "defproducera"_n; // the first of those `active_and_vote_producers` registers
+
+auto xyz(const char* amount) { return eosio_system_tester::xyz(amount); }
+auto eos(const char* amount) { return eosio_system_tester::eos(amount); }
+
+// Setup, on the test thread: alice, bob and carol with resources and 1000 EOS each.
+void fund(eosio_system_tester& t) {
+   t.create_accounts_with_resources({ alice, bob, carol });
+   for (auto a : { alice, bob, carol })
+      t.eosio_token.transfer(t.eos_name, a, eos("1000.0000"));
+}
+
+// Setup, on the test thread: gives `owner` XYZ.
+void swap(eosio_system_tester& t, account_name owner, const char* quantity) {
+   t.eosio_token.transfer(owner, t.xyz_name, eos(quantity));
+}
+
+// Pushes actions on one scenario's chain and records what each of them cost. It runs on a worker thread, so it only
+// pushes raw transactions, which throw on failure instead of using Boost.Test assertions.
+struct bench_chain {
+   eosio_system_tester&      t;
+   std::vector<bench_sample> samples;
+
+   // billed_cpu_time_us = 0 bills the measured CPU instead of the tester's fixed default, which the baseline check
+   // could never catch going up
+   transaction_trace_ptr push(account_name code, action_name act, account_name signer, const variant_object& data) {
+      auto trace = t.push_raw({ t.get_action(code, act, { { signer, config::active_name } }, data) }, 0);
+      t.produce_block();
+      return trace;
+   }
+
+   void bench(const std::string& label, account_name code, action_name act, account_name signer,
+              const variant_object& data) {
+      samples.push_back(make_bench_sample(label, push(code, act, signer, data)));
+   }
+
+   void xyz_action(action_name act, account_name signer, const variant_object& data) {
+      bench(act.to_string(), t.xyz_name, act, signer, data);
+   }
+};
+
+// The actions of the contract, in scenarios that each run on their own chain. Every action is benchmarked but:
+//   init                 runs once, when the contract is deployed
+//   enforcebal, swapexcess, swaptrace, rexexcess, fundexcess
+//                        inline actions the contract sends to itself, which need its own authority; their cost is
+//                        part of the numbers of the actions that send them
+std::vector<scenario> bench_scenarios() {
+   std::vector<scenario> scenarios;
+
+   scenarios.push_back({ "swaps and token", fund, [](eosio_system_tester& t) {
+      bench_chain c{ t };
+      // every swap is counted (see `count_usage`): the first one of an hour adds that hour's row to the ring, the
+      // next ones update it in place, so the two samples below differ by what adding the row costs
+      t.produce_block(fc::seconds(3600 - t.control->pending_block_time().sec_since_epoch() % 3600));
+      c.bench("on_transfer", "eosio.token"_n, "transfer"_n, alice,
+              mvo()("from", alice)("to", t.xyz_name)("quantity", eos("490.0000"))("memo", ""));
+      c.bench("on_transfer_repeat", "eosio.token"_n, "transfer"_n, alice,
+              mvo()("from", alice)("to", t.xyz_name)("quantity", eos("10.0000"))("memo", ""));
+      // the two ways a contract-paid row is handed to its owner: alice's on her first debit, and bob's, which
+      // alice's transfers create, ahead of time with `release`, after which his first debit is a plain one
+      c.bench("transfer_first_debit", t.xyz_name, "transfer"_n, alice,
+              mvo()("from", alice)("to", bob)("quantity", xyz("10.0000"))("memo", ""));
+      c.xyz_action("transfer"_n, alice, mvo()("from", alice)("to", bob)("quantity", xyz("10.0000"))("memo", ""));
+      c.bench("transfer_to_self", t.xyz_name, "transfer"_n, alice,
+              mvo()("from", alice)("to", t.xyz_name)("quantity", xyz("10.0000"))("memo", ""));
+      c.xyz_action("release"_n, bob, mvo()("owner", bob));
+      c.bench("transfer_after_release", t.xyz_name, "transfer"_n, bob,
+              mvo()("from", bob)("to", alice)("quantity", xyz("1.0000"))("memo", ""));
+      c.bench("swapto_eos", t.xyz_name, "swapto"_n, alice,
+              mvo()("from", alice)("to", carol)("quantity", eos("10.0000"))("memo", ""));
+      c.bench("swapto_xyz", t.xyz_name, "swapto"_n, alice,
+              mvo()("from", alice)("to", carol)("quantity", xyz("10.0000"))("memo", ""));
+      c.xyz_action("swapall"_n, carol, mvo()("account", carol)("symbol", t.xyz_symbol()));
+      c.xyz_action("close"_n, carol, mvo()("owner", carol)("symbol", t.xyz_symbol()));
+      c.xyz_action("blockswapto"_n, carol, mvo()("account", carol)("block", true));
+      c.xyz_action("open"_n, carol, mvo()("owner", carol)("symbol", t.xyz_symbol())("ram_payer", carol));
+      c.xyz_action("queueswap"_n, alice, mvo()("account", alice)("quantity", xyz("1.0000")));
+      c.xyz_action("processq"_n, bob, mvo()("max_items", 1));
+      c.xyz_action("setrelaykey"_n, alice, mvo()("account", alice)("key", t.get_public_key(alice, "active")));
+      const auto expiry = time_point_sec(t.control->head().block_time()) + 3600;
+      c.xyz_action("relayswaps"_n, bob,
+                   mvo()("intents", std::vector<fc::variant>{ t.signed_swap_intent(alice, xyz("1.0000"), 1, expiry) }));
+      c.xyz_action("bulkcredit"_n, t.xyz_name,
+                   mvo()("batch", "bench")("offset", 0)(
+                      "credits", std::vector<fc::variant>{ mvo()("account", carol)("quantity", xyz("1.0000")) }));
+      c.xyz_action("audit"_n, alice, mvo());
+      c.xyz_action("migrate"_n, t.xyz_name, mvo()("max_rows", 10));
+      c.xyz_action("migrateaccts"_n, t.xyz_name, mvo()("owners", std::vector<name>{ alice, bob }));
+      const auto aggregates = t.get_xyz_aggregates();
+      c.xyz_action("setaggr"_n, t.xyz_name,
+                   mvo()("holders", aggregates["holders"])("contract_rows", aggregates["contract_rows"]));
+      c.xyz_action("noop"_n, alice, mvo()("memo", "bench"));
+      return c.samples;
+   } });
+
+   scenarios.push_back({ "RAM",
+      [](eosio_system_tester& t) {
+         fund(t);
+         swap(t, alice, "500.0000");
+      },
+      [](eosio_system_tester& t) {
+         bench_chain c{ t };
+         c.xyz_action("buyram"_n, alice, mvo()("payer", alice)("receiver", alice)("quant", xyz("10.0000")));
+         c.xyz_action("buyramself"_n, alice, mvo()("payer", alice)("quant", xyz("10.0000")));
+         c.xyz_action("buyrambytes"_n, alice, mvo()("payer", alice)("receiver", alice)("bytes", 1024));
+         c.xyz_action("buyramburn"_n, alice, mvo()("payer", alice)("quantity", xyz("1.0000"))("memo", ""));
+         c.xyz_action("ramtransfer"_n, alice, mvo()("from", alice)("to", bob)("bytes", 512)("memo", ""));
+         c.xyz_action("ramburn"_n, alice, mvo()("owner", alice)("bytes", 256)("memo", ""));
+         c.xyz_action("sellram"_n, bob, mvo()("account", bob)("bytes", 512));
+         c.xyz_action("giftram"_n, alice, mvo()("from", alice)("receiver", bob)("ram_bytes", 10)("memo", ""));
+         c.xyz_action("ungiftram"_n, bob, mvo()("from", bob)("to", alice)("memo", ""));
+         return c.samples;
+      } });
+
+   scenarios.push_back({ "REX",
+      [](eosio_system_tester& t) {
+         fund(t);
+         swap(t, alice, "500.0000");
+         swap(t, bob, "10.0000");
+         t.base_tester::push_action(config::system_account_name, "delegatebw"_n, alice,
+                                    mvo()("from", alice)("receiver", alice)("stake_net_quantity", eos("5.0000"))(
+                                       "stake_cpu_quantity", eos("5.0000"))("transfer", false));
+         t.produce_block();
+      },
+      [](eosio_system_tester& t) {
+         bench_chain c{ t };
+         c.xyz_action("deposit"_n, alice, mvo()("owner", alice)("amount", xyz("10.0000")));
+         c.xyz_action("buyrex"_n, alice, mvo()("from", alice)("amount", xyz("2.0000")));
+         c.xyz_action("unstaketorex"_n, alice,
+                      mvo()("owner", alice)("receiver", alice)("from_net", xyz("0.0000"))("from_cpu", xyz("1.0000")));
+         c.xyz_action("donatetorex"_n, alice, mvo()("payer", alice)("quantity", xyz("1.0000"))("memo", ""));
+         c.xyz_action("withdraw"_n, alice, mvo()("owner", alice)("amount", xyz("1.0000")));
+         c.xyz_action("mvtosavings"_n, alice, mvo()("owner", alice)("rex", t.get_rex_balance(alice)));
+         c.xyz_action("mvfrsavings"_n, alice, mvo()("owner", alice)("rex", t.get_rex_balance(alice)));
+         c.xyz_action("rexin"_n, bob, mvo()("owner", bob)("amount", xyz("2.0000")));
+
+         t.produce_block(fc::days(30)); // REX maturity
+
+         c.xyz_action("sellrex"_n, alice, mvo()("from", alice)("rex", t.get_rex_balance(alice)));
+         c.xyz_action("rexout"_n, bob, mvo()("owner", bob)("rex", t.get_rex_balance(bob)));
+         return c.samples;
+      } });
+
+   scenarios.push_back({ "staking and voting",
+      [](eosio_system_tester& t) {
+         fund(t);
+         swap(t, alice, "500.0000");
+         t.active_and_vote_producers(); // needed by `undelegatebw` and `voteproducer`
+         t.configure_powerup(eos("100.0000"), eos("0.0001"));
+         t.produce_block();
+      },
+      [](eosio_system_tester& t) {
+         bench_chain c{ t };
+         c.xyz_action("delegatebw"_n, alice,
+                      mvo()("from", alice)("receiver", alice)("stake_net_quantity", xyz("5.0000"))(
+                         "stake_cpu_quantity", xyz("5.0000"))("transfer", false));
+         c.xyz_action("voteproducer"_n, alice,
+                      mvo()("voter", alice)("proxy", name())("producers", std::vector<name>{ producer }));
+         c.xyz_action("voteupdate"_n, alice, mvo()("voter_name", alice));
+         c.xyz_action("undelegatebw"_n, alice,
+                      mvo()("from", alice)("receiver", alice)("unstake_net_quantity", xyz("1.0000"))(
+                         "unstake_cpu_quantity", xyz("1.0000")));
+         c.xyz_action("powerup"_n, alice,
+                      mvo()("payer", alice)("receiver", alice)("days", 30)("net_frac", powerup_frac / 10'000'000)(
+                         "cpu_frac", powerup_frac / 10'000'000)("max_payment", xyz("10.0000")));
+
+         t.produce_block(fc::days(30)); // the unstake delay
+
+         c.xyz_action("refund"_n, alice, mvo()("owner", alice));
+         c.xyz_action("claimrewards"_n, producer, mvo()("owner", producer));
+         return c.samples;
+      } });
+
+   scenarios.push_back({ "accounts",
+      [](eosio_system_tester& t) {
+         fund(t);
+         swap(t, alice, "500.0000");
+         swap(t, bob, "10.0000");
+
+         // room and CPU for `setcode`
+         t.create_account_with_resources(code, config::system_account_name, 5'000'000);
+         t.base_tester::push_action(config::system_account_name, "delegatebw"_n, config::system_account_name,
+                                    mvo()("from", config::system_account_name)("receiver", code)(
+                                       "stake_net_quantity", eos("10.0000"))("stake_cpu_quantity", eos("500.0000"))(
+                                       "transfer", false));
+         t.produce_block();
+      },
+      [](eosio_system_tester& t) {
+         bench_chain c{ t };
+         c.xyz_action("newaccount2"_n, alice,
+                      mvo()("creator", alice)("name", "benchacct1")("key", t.get_public_key("benchacct1"_n, "active")));
+         c.xyz_action("createacct"_n, alice,
+                      mvo()("creator", alice)("name", "benchacct2")("key", t.get_public_key("benchacct2"_n, "active"))(
+                         "ram_bytes", 3000)("stake_net_quantity", xyz("1.0000"))("stake_cpu_quantity", xyz("1.0000")));
+         const authority key(t.get_public_key("benchacct3"_n, "active"));
+         c.xyz_action("newaccount"_n, alice,
+                      mvo()("creator", alice)("name", "benchacct3")("owner", key)("active", key));
+
+         c.xyz_action("bidname"_n, alice, mvo()("bidder", alice)("newname", "benchname")("bid", xyz("1.0000")));
+         c.push(t.xyz_name, "bidname"_n, bob, mvo()("bidder", bob)("newname", "benchname")("bid", xyz("1.5000")));
+         c.xyz_action("bidrefund"_n, alice, mvo()("bidder", alice)("newname", "benchname"));
+
+         const authority bench_auth(1, { key_weight{ t.get_public_key(alice, "active"), 1 } });
+         c.xyz_action("updateauth"_n, alice,
+                      mvo()("account", alice)("permission", "bench")("parent", "active")("auth", bench_auth));
+         c.xyz_action("linkauth"_n, alice,
+                      mvo()("account", alice)("code", t.xyz_name)("type", "transfer")("requirement", "bench"));
+         c.xyz_action("unlinkauth"_n, alice, mvo()("account", alice)("code", t.xyz_name)("type", "transfer"));
+         c.xyz_action("deleteauth"_n, alice, mvo()("account", alice)("permission", "bench"));
+
+         const auto wasm = eos_contracts::fees_wasm();
+         c.xyz_action("setcode"_n, code,
+                      mvo()("account", code)("vmtype", 0)("vmversion", 0)("code", bytes(wasm.begin(), wasm.end()))(
+                         "memo", ""));
+         c.xyz_action("setabi"_n, code, mvo()("account", code)("abi", eos_contracts::token_abi())("memo", ""));
+         return c.samples;
+      } });
+
+   return scenarios;
+}
+
+} // namespace
+
+// Measures what every user-facing action of the xyz contract costs, writes the numbers to a JSON report and,
+// when a baseline report is given, fails if an action got more expensive (see bench_report.hpp).
+//
+// The actions are grouped in scenarios that each run on their own chain (see scenario_runner.hpp), on
+// XYZ_BENCH_THREADS threads (default: 1). Scenarios running side by side skew each other's billed CPU, so more threads
+// are only used when no baseline is checked (XYZ_BENCH_BASELINE set to an empty string). The results are checked here,
+// on the test thread, once every scenario is done.
+BOOST_AUTO_TEST_SUITE(bench_tests);
+
+BOOST_AUTO_TEST_CASE(action_costs) try {
+   const char* threads_env = std::getenv("XYZ_BENCH_THREADS");
+   size_t      threads     = threads_env ? std::strtoul(threads_env, nullptr, 10) : 1;
+   if (threads > 1 && !bench_report::baseline_path().empty()) {
+      BOOST_TEST_MESSAGE("checking a baseline: running the scenarios on 1 thread instead of " << threads);
+      threads = 1;
+   }
+
+   bench_report report;
+   for (auto& r : run_scenarios(bench_scenarios(), threads)) {
+      BOOST_REQUIRE_MESSAGE(r.error.empty(), r.name << ": " << r.error);
+      BOOST_TEST_MESSAGE(r.name << ": " << r.elapsed_ms << "ms");
+      for (auto& s : r.samples)
+         report.add(std::move(s));
+   }
+
+   for (const auto& s : report.samples())
+      BOOST_TEST_MESSAGE(s.label << ": " << s.billed_cpu_us << "us CPU, " << s.net_bytes << " NET, "
+                                 << s.inline_actions << " inline, " << s.ram_delta << " RAM");
+   report.write();
+   report.check_baseline();
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,189 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fc/io/json.hpp>
+#include "contracts.hpp"
+
+#include "eosio.system_tester.hpp"
+#include "signing_pipeline.hpp"
+
+#include <cstdlib>
+#include <sstream>
+
+using namespace eosio_system;
+
+namespace xyz_load {
+
+// What was packed into one block, and how much of the block CPU it used.
+struct block_stats {
+   uint32_t block_num        = 0;
+   uint32_t transactions     = 0;
+   uint32_t on_transfers     = 0; // EOS sent to the contract, swapped to XYZ
+   uint32_t swaptos          = 0; // XYZ swapped to EOS and sent to another account
+   uint32_t powerups         = 0; // powerups paid in XYZ
+   uint32_t skipped          = 0; // transactions rejected because the sending account ran out of CPU
+   uint64_t cpu_usage_us     = 0;
+   uint32_t max_block_cpu_us = 0;
+   double   cpu_utilization  = 0;
+};
+
+enum class kind { on_transfer, swapto, powerup };
+
+// Environment:
+//   XYZ_LOAD_ACCOUNTS   number of accounts sending transactions (default: 2000)
+//   XYZ_LOAD_BLOCKS     number of blocks to fill (default: 3)
+//   XYZ_LOAD_MIX        relative weight of each kind of transaction (default: on_transfer=5,swapto=3,powerup=2)
+//   XYZ_LOAD_SIGNERS    threads signing transactions ahead of the test thread (default: one per core but one)
+//   XYZ_LOAD_REPORT     where to write the report (default: xyz_load_report.json)
+struct load_config {
+   uint32_t          accounts = 2000;
+   uint32_t          blocks   = 3;
+   std::vector<kind> mix; // one entry per unit of weight, cycled through when filling blocks
+   size_t            signers  = signing_pipeline::default_threads();
+   std::string       report   = "xyz_load_report.json";
+
+   static load_config from_env() {
+      load_config c;
+      if (const char* v = std::getenv("XYZ_LOAD_ACCOUNTS"))
+         c.accounts = std::strtoul(v, nullptr, 10);
+      if (const char* v = std::getenv("XYZ_LOAD_BLOCKS"))
+         c.blocks = std::strtoul(v, nullptr, 10);
+      if (const char* v = std::getenv("XYZ_LOAD_SIGNERS"))
+         c.signers = std::strtoul(v, nullptr, 10);
+      if (const char* v = std::getenv("XYZ_LOAD_REPORT"))
+         c.report = v;
+
+      const char*        mix = std::getenv("XYZ_LOAD_MIX");
+      std::istringstream in(mix ? mix : "on_transfer=5,swapto=3,powerup=2");
+      for (std::string entry; std::getline(in, entry, ',');) {
+         auto        eq     = entry.find('=');
+         std::string label  = entry.substr(0, eq);
+         uint32_t    weight = eq == std::string::npos ? 1 : std::strtoul(entry.c_str() + eq + 1, nullptr, 10);
+         kind        k;
+         if (label == "on_transfer")
+            k = kind::on_transfer;
+         else if (label == "swapto")
+            k = kind::swapto;
+         else if (label == "powerup")
+            k = kind::powerup;
+         else
+            BOOST_FAIL("unknown transaction kind in XYZ_LOAD_MIX: " << label);
+         c.mix.insert(c.mix.end(), weight, k);
+      }
+      BOOST_REQUIRE_MESSAGE(!c.mix.empty(), "XYZ_LOAD_MIX has no weight");
+      BOOST_REQUIRE_MESSAGE(c.accounts >= 2, "XYZ_LOAD_ACCOUNTS must be at least 2");
+      BOOST_REQUIRE_MESSAGE(c.signers >= 1, "XYZ_LOAD_SIGNERS must be at least 1");
+      return c;
+   }
+};
+
+} // namespace xyz_load
+
+FC_REFLECT(xyz_load::block_stats, (block_num)(transactions)(on_transfers)(swaptos)(powerups)(skipped)(cpu_usage_us)(
+                                     max_block_cpu_us)(cpu_utilization))
+
+// How many swaps and wrapped powerups fit in a block. Fills blocks with single-action transactions from many
+// accounts until the block CPU limit is reached, and reports what each block holds and how much of its CPU it used.
+BOOST_AUTO_TEST_SUITE(load_tests);
+
+BOOST_FIXTURE_TEST_CASE(block_capacity, eosio_system_tester) try {
+   using namespace xyz_load;
+   const auto cfg = load_config::from_env();
+
+   // A small `min_price` keeps the many small powerups above `min_powerup_fee`, which is lowered to match.
+   configure_powerup(eos("100.0000"), eos("0.0001"));
+   const auto accounts = create_accounts_bulk("load", cfg.accounts, eos("1000.0000"));
+
+   for (uint32_t first = 0; first < accounts.size(); first += 200) {
+      xyz_raw::bulkcredit credit{.batch = "load"_n, .offset = first};
+      for (uint32_t i = first; i < std::min<uint32_t>(accounts.size(), first + 200); ++i)
+         credit.credits.push_back({accounts[i], xyz("1000.0000")});
+      push_raw({ xyz_raw::make_action(xyz_name, xyz_name, credit) });
+      produce_block();
+   }
+   produce_block();
+
+   const uint32_t max_block_cpu_us = control->get_global_properties().configuration.max_block_cpu_usage;
+
+   // Transactions are signed ahead on the other cores (see signing_pipeline.hpp), with headers that stay valid for the
+   // blocks it takes to push the ones built ahead. Their number makes each one unique, even when an account sends
+   // twice in a block.
+   auto headers = [&] {
+      transaction trx;
+      set_transaction_headers(trx, 600);
+      return trx;
+   };
+   auto kind_of = [&](uint64_t seq) { return cfg.mix[seq % cfg.mix.size()]; };
+   auto build   = [&](uint64_t seq) {
+      const auto        from = accounts[seq % accounts.size()];
+      const auto        to   = accounts[(seq + 1) % accounts.size()];
+      const std::string memo = std::to_string(seq);
+
+      action act;
+      switch (kind_of(seq)) {
+      case kind::on_transfer:
+         act = xyz_raw::make_action("eosio.token"_n, from, xyz_raw::transfer{from, xyz_name, eos("0.1000"), memo});
+         break;
+      case kind::swapto:
+         act = xyz_raw::make_action(xyz_name, from, xyz_raw::swapto{from, to, xyz("0.1000"), memo});
+         break;
+      case kind::powerup:
+         act = xyz_raw::make_action(xyz_name, from,
+                                    xyz_raw::powerup{from, from, 30, powerup_frac / 10'000'000 + int64_t(seq),
+                                                     powerup_frac / 10'000'000, xyz("10.0000")});
+         break;
+      }
+      return std::vector<action>{ std::move(act) };
+   };
+   signing_pipeline pipeline(build, control->get_chain_id(), headers(), cfg.signers);
+
+   std::vector<block_stats> report;
+   for (uint32_t b = 0; b < cfg.blocks; ++b) {
+      block_stats stats{.max_block_cpu_us = max_block_cpu_us};
+
+      for (uint32_t consecutive_skips = 0; consecutive_skips < accounts.size();) {
+         auto       next = pipeline.next();
+         const auto k    = kind_of(next.seq);
+
+         try {
+            // billed_cpu_time_us = 0 bills the measured CPU instead of the tester's fixed default
+            push_transaction(next.trx, fc::time_point::maximum(), 0);
+         } catch (const block_cpu_usage_exceeded&) {
+            break;
+         } catch (const block_net_usage_exceeded&) {
+            break;
+         } catch (const tx_cpu_usage_exceeded&) {
+            ++stats.skipped; // this account is out of CPU, others may still fit
+            ++consecutive_skips;
+            continue;
+         }
+         consecutive_skips = 0;
+
+         ++stats.transactions;
+         switch (k) {
+         case kind::on_transfer: ++stats.on_transfers; break;
+         case kind::swapto:      ++stats.swaptos;      break;
+         case kind::powerup:     ++stats.powerups;     break;
+         }
+      }
+
+      auto block      = produce_block();
+      stats.block_num = block->block_num();
+      pipeline.set_headers(headers());
+      for (const auto& r : block->transactions)
+         stats.cpu_usage_us += r.cpu_usage_us;
+      stats.cpu_utilization = double(stats.cpu_usage_us) / max_block_cpu_us;
+
+      BOOST_TEST_MESSAGE("block " << stats.block_num << ": " << stats.transactions << " transactions ("
+                                  << stats.on_transfers << " on_transfer, " << stats.swaptos << " swapto, "
+                                  << stats.powerups << " powerup, " << stats.skipped << " skipped), "
+                                  << stats.cpu_usage_us << "/" << max_block_cpu_us << "us CPU ("
+                                  << stats.cpu_utilization * 100 << "%)");
+      BOOST_CHECK_EQUAL(block->transactions.size(), stats.transactions);
+      report.push_back(stats);
+   }
+
+   fc::json::save_to_file(fc::variant(report), cfg.report, true);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
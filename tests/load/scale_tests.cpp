@@ -0,0 +1,161 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <fc/io/json.hpp>
+#include "contracts.hpp"
+
+#include "bench_report.hpp"
+#include "eosio.system_tester.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+using namespace eosio_system;
+
+namespace xyz_scale {
+
+// The contract's footprint and the cost of its actions once `holders` accounts hold XYZ.
+struct scale_step {
+   uint32_t                  holders            = 0;
+   uint32_t                  blocked            = 0; // rows of the `blocked` table
+   int64_t                   contract_ram_bytes = 0; // RAM used by the contract account
+   fc::variant               aggregates;             // the contract's own count of rows and RAM, see `aggregates`
+   std::vector<bench_sample> actions;                // averages over XYZ_SCALE_SAMPLES runs
+};
+
+// Environment:
+//   XYZ_SCALE_STEPS      holder counts to grow to, in order (default: 10000,100000,1000000)
+//   XYZ_SCALE_SAMPLES    runs of each action averaged at every step (default: 20)
+//   XYZ_SCALE_STATE_GB   chain state size, which must fit every holder account (default: 32)
+//   XYZ_SCALE_REPORT     where to write the report (default: xyz_scale_report.json)
+struct scale_config {
+   std::vector<uint32_t> steps;
+   uint32_t              samples  = 20;
+   uint64_t              state_gb = 32;
+   std::string           report   = "xyz_scale_report.json";
+
+   static scale_config from_env() {
+      scale_config c;
+      if (const char* v = std::getenv("XYZ_SCALE_SAMPLES"))
+         c.samples = std::strtoul(v, nullptr, 10);
+      if (const char* v = std::getenv("XYZ_SCALE_STATE_GB"))
+         c.state_gb = std::strtoull(v, nullptr, 10);
+      if (const char* v = std::getenv("XYZ_SCALE_REPORT"))
+         c.report = v;
+
+      const char*        steps = std::getenv("XYZ_SCALE_STEPS");
+      std::istringstream in(steps ? steps : "10000,100000,1000000");
+      for (std::string s; std::getline(in, s, ',');)
+         c.steps.push_back(std::strtoul(s.c_str(), nullptr, 10));
+      BOOST_REQUIRE_MESSAGE(std::is_sorted(c.steps.begin(), c.steps.end()), "XYZ_SCALE_STEPS must be increasing");
+      BOOST_REQUIRE_MESSAGE(c.steps.size() <= 26, "XYZ_SCALE_STEPS has too many steps");
+      BOOST_REQUIRE_MESSAGE(c.samples > 0, "XYZ_SCALE_SAMPLES must be positive");
+      return c;
+   }
+};
+
+} // namespace xyz_scale
+
+FC_REFLECT(xyz_scale::scale_step, (holders)(blocked)(contract_ram_bytes)(aggregates)(actions))
+
+// How the contract's RAM and the CPU of its actions grow with the number of XYZ holders. Grows the holder set in
+// steps, each new holder getting a contract-paid balance row and one in a hundred a `blocked` row, and at each step
+// averages the cost of the actions that look up those tables.
+BOOST_AUTO_TEST_SUITE(scale_tests);
+
+BOOST_AUTO_TEST_CASE(holder_scale) try {
+   using namespace xyz_scale;
+   const auto cfg = scale_config::from_env();
+   configured_system_tester t([&](controller::config& c) { c.state_size = cfg.state_gb << 30; });
+
+   const account_name probe = "scaleprobe"_n;
+   t.create_account_with_resources(probe, config::system_account_name);
+   t.eosio_token.transfer(t.eos_name, probe, t.eos("1000000.0000"));
+   t.eosio_token.transfer(probe, t.xyz_name, t.eos("100000.0000"));
+
+   // billed_cpu_time_us = 0 bills the measured CPU instead of the tester's fixed default
+   auto measure = [&](const std::string& label, action act) {
+      return make_bench_sample(label, t.push_raw({ std::move(act) }, 0));
+   };
+
+   std::vector<scale_step> report;
+   uint32_t                holders = 0, blocked = 0;
+   for (size_t i = 0; i < cfg.steps.size(); ++i) {
+      if (cfg.steps[i] <= holders)
+         continue;
+
+      // grow the holder set
+      // -------------------
+      const std::string prefix = std::string("scale") + char('a' + i);
+      const auto added = t.create_accounts_bulk(prefix, cfg.steps[i] - holders, t.eos("0.0000"), 50, 5000);
+
+      for (uint32_t first = 0; first < added.size(); first += 200) {
+         xyz_raw::bulkcredit credit{.batch = name(prefix), .offset = first};
+         for (uint32_t j = first; j < std::min<uint32_t>(added.size(), first + 200); ++j)
+            credit.credits.push_back({added[j], t.xyz("10.0000")});
+         t.push_raw({ xyz_raw::make_action(t.xyz_name, t.xyz_name, credit) });
+         t.produce_block();
+      }
+
+      for (uint32_t first = 0; first < added.size(); first += 100 * 50) {
+         vector<action> blocks;
+         for (uint32_t j = first; j < std::min<uint32_t>(added.size(), first + 100 * 50); j += 100) {
+            blocks.push_back(xyz_raw::make_action(t.xyz_name, added[j], xyz_raw::blockswapto{added[j], true}));
+            ++blocked;
+         }
+         t.push_raw(std::move(blocks));
+         t.produce_block();
+      }
+      holders = cfg.steps[i];
+
+      // measure
+      // -------
+      std::map<std::string, std::vector<bench_sample>> runs;
+      auto run = [&](const std::string& label, action act) { runs[label].push_back(measure(label, std::move(act))); };
+
+      // holders of this step that are not blocked, spread over the whole step
+      const uint32_t stride = std::max<uint32_t>(1, added.size() / (cfg.samples * 2 + 1));
+      auto           pick   = [&](uint32_t k) {
+         const uint32_t j = k * stride % added.size();
+         return added[j % 100 == 0 ? (j + 1) % added.size() : j];
+      };
+      for (uint32_t n = 0; n < cfg.samples; ++n) {
+         const account_name holder = pick(2 * n + 1);
+         const account_name other  = pick(2 * n + 2);
+         const std::string  memo   = std::to_string(holders) + "/" + std::to_string(n);
+
+         run("on_transfer", xyz_raw::make_action("eosio.token"_n, probe,
+                                                 xyz_raw::transfer{probe, t.xyz_name, t.eos("1.0000"), memo}));
+         run("transfer_to_holder",
+             xyz_raw::make_action(t.xyz_name, probe, xyz_raw::transfer{probe, holder, t.xyz("1.0000"), memo}));
+         run("transfer_first_debit",
+             xyz_raw::make_action(t.xyz_name, holder, xyz_raw::transfer{holder, probe, t.xyz("1.0000"), memo}));
+         run("swapto_holder",
+             xyz_raw::make_action(t.xyz_name, probe, xyz_raw::swapto{probe, other, t.xyz("1.0000"), memo}));
+         run("blockswapto", xyz_raw::make_action(t.xyz_name, holder, xyz_raw::blockswapto{holder, true}));
+         run("audit", action({ { probe, config::active_name } }, t.xyz_name, "audit"_n, bytes()));
+         ++blocked;
+         t.produce_block();
+      }
+
+      scale_step step{.holders            = holders,
+                      .blocked            = blocked,
+                      .contract_ram_bytes = t.control->get_resource_limits_manager().get_account_ram_usage(t.xyz_name),
+                      .aggregates         = t.get_xyz_aggregates()};
+      for (const auto& [label, samples] : runs)
+         step.actions.push_back(average_samples(label, samples));
+
+      BOOST_TEST_MESSAGE(holders << " holders, " << blocked << " blocked: contract RAM " << step.contract_ram_bytes
+                                 << " bytes");
+      for (const auto& s : step.actions)
+         BOOST_TEST_MESSAGE("   " << s.label << ": " << s.elapsed_us << "us elapsed, " << s.billed_cpu_us
+                                  << "us CPU, " << s.ram_delta << " RAM");
+      report.push_back(std::move(step));
+      fc::json::save_to_file(fc::variant(report), cfg.report, true); // keep what was measured if a later step fails
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
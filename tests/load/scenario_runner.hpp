@@ -0,0 +1,108 @@
+#pragma once
+
+#include "bench_report.hpp"
+#include "eosio.system_tester.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace eosio_system {
+
+// A piece of a benchmark pass that runs on a chain of its own.
+//
+// Boost.Test assertions are not thread safe, and most tester helpers use them, so a scenario is split in two: `setup`
+// runs on the test thread and may use any helper, `run` runs on a worker thread, only pushes raw transactions
+// (`push_raw`), reports through its samples and fails by throwing.
+struct scenario {
+   std::string                                                    name;
+   std::function<void(eosio_system_tester&)>                      setup;
+   std::function<std::vector<bench_sample>(eosio_system_tester&)> run;
+};
+
+struct scenario_result {
+   std::string               name;
+   std::vector<bench_sample> samples;
+   std::string               error;          // empty when `run` completed
+   int64_t                   elapsed_ms = 0; // of `run`
+};
+
+// Sets every scenario up on its own `eosio_system_tester`, each with its own state directory, on the calling thread,
+// then runs them on `threads` threads. Scenarios are dealt to the threads in turn; a thread that is done with its own
+// takes the last one of another thread. Results are in the order of `scenarios`; the caller checks them once this
+// returns, on the test thread.
+inline std::vector<scenario_result> run_scenarios(const std::vector<scenario>& scenarios, size_t threads) {
+   std::vector<scenario_result> results(scenarios.size());
+   if (scenarios.empty())
+      return results;
+
+   // all the chains are alive at once: a worker never builds a tester nor sets one up
+   std::vector<std::unique_ptr<eosio_system_tester>> chains;
+   for (const auto& s : scenarios) {
+      chains.push_back(std::make_unique<eosio_system_tester>());
+      if (s.setup)
+         s.setup(*chains.back());
+   }
+
+   struct work_queue {
+      std::mutex         mtx;
+      std::deque<size_t> items;
+   };
+   threads = std::clamp<size_t>(threads, 1, scenarios.size());
+   std::vector<work_queue> queues(threads);
+   for (size_t i = 0; i < scenarios.size(); ++i)
+      queues[i % threads].items.push_back(i);
+
+   auto take = [&](size_t self) -> std::optional<size_t> {
+      for (size_t k = 0; k < threads; ++k) {
+         auto&           q = queues[(self + k) % threads];
+         std::lock_guard lock(q.mtx);
+         if (q.items.empty())
+            continue;
+         size_t i;
+         if (k == 0) {
+            i = q.items.front();
+            q.items.pop_front();
+         } else {
+            i = q.items.back();
+            q.items.pop_back();
+         }
+         return i;
+      }
+      return {};
+   };
+
+   auto work = [&](size_t self) {
+      while (auto i = take(self)) {
+         auto& r    = results[*i];
+         r.name     = scenarios[*i].name;
+         auto start = fc::time_point::now();
+         try {
+            r.samples = scenarios[*i].run(*chains[*i]);
+         } catch (const fc::exception& e) {
+            r.error = e.to_detail_string();
+         } catch (const std::exception& e) {
+            r.error = e.what();
+         } catch (...) {
+            r.error = "failed";
+         }
+         r.elapsed_ms = (fc::time_point::now() - start).count() / 1000;
+      }
+   };
+
+   std::vector<std::thread> pool;
+   for (size_t t = 1; t < threads; ++t)
+      pool.emplace_back(work, t);
+   work(0);
+   for (auto& t : pool)
+      t.join();
+   return results;
+}
+
+} // namespace eosio_system
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <eosio/testing/tester.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xyz_load {
+
+using namespace eosio::chain;
+
+// Builds and signs transactions on a pool of worker threads while the test thread pushes the ones already signed, so
+// that a load test is limited by the chain rather than by secp256k1 signing.
+//
+// Transactions are numbered in the order workers start them; `build` turns a number into the actions of one
+// transaction and must not touch the controller. Each transaction is signed with the active key of every authorizer
+// of its actions. They are handed out in the order they finish, which is not necessarily their number order. When
+// building or signing throws, the pipeline stops and `next` rethrows the exception on the test thread.
+class signing_pipeline {
+public:
+   using build_fn = std::function<std::vector<action>(uint64_t seq)>;
+
+   struct signed_trx {
+      uint64_t           seq = 0;
+      signed_transaction trx;
+   };
+
+   // One worker per core but the one the test thread pushes on, so that signing doesn't compete with the controller
+   // whose CPU use is being measured.
+   static size_t default_threads() { return std::max(2u, std::thread::hardware_concurrency()) - 1; }
+
+   // `headers` holds the TAPOS and expiration given to the transactions, see `set_headers`. At most `depth`
+   // transactions are built ahead of the test thread.
+   signing_pipeline(build_fn build, const chain_id_type& chain_id, const transaction& headers,
+                    size_t threads = default_threads(), size_t depth = 4096)
+      : _build(std::move(build))
+      , _chain_id(chain_id)
+      , _headers(headers)
+      , _depth(depth) {
+      for (size_t i = 0; i < threads; ++i)
+         _workers.emplace_back([this] { work(); });
+   }
+
+   ~signing_pipeline() {
+      {
+         std::lock_guard lock(_mtx);
+         _stopping = true;
+      }
+      _space.notify_all();
+      for (auto& w : _workers)
+         w.join();
+   }
+
+   signing_pipeline(const signing_pipeline&)            = delete;
+   signing_pipeline& operator=(const signing_pipeline&) = delete;
+
+   // The next signed transaction, waiting for one if none is ready. Rethrows what a worker failed with.
+   signed_trx next() {
+      std::unique_lock lock(_mtx);
+      _ready_cv.wait(lock, [this] { return _error || !_ready.empty(); });
+      if (_error)
+         std::rethrow_exception(_error);
+      signed_trx t = std::move(_ready.front());
+      _ready.pop_front();
+      _space.notify_one();
+      return t;
+   }
+
+   // Headers of the transactions built from now on. Transactions already built keep theirs, so headers should
+   // expire late enough for those to be pushed first.
+   void set_headers(const transaction& headers) {
+      std::lock_guard lock(_mtx);
+      _headers = headers;
+   }
+
+private:
+   void work() {
+      while (true) {
+         signed_trx t;
+         {
+            std::unique_lock lock(_mtx);
+            _space.wait(lock, [this] { return _stopping || _ready.size() + _in_flight < _depth; });
+            if (_stopping)
+               return;
+            t.seq = _next_seq++;
+            static_cast<transaction&>(t.trx) = _headers;
+            ++_in_flight;
+         }
+
+         try {
+            t.trx.actions = _build(t.seq);
+            flat_set<account_name> signers;
+            for (const auto& a : t.trx.actions)
+               for (const auto& auth : a.authorization)
+                  signers.insert(auth.actor);
+            for (auto signer : signers)
+               t.trx.sign(eosio::testing::base_tester::get_private_key(signer, "active"), _chain_id);
+         } catch (...) {
+            {
+               std::lock_guard lock(_mtx);
+               --_in_flight;
+               if (!_error)
+                  _error = std::current_exception();
+               _stopping = true;
+            }
+            _ready_cv.notify_all();
+            _space.notify_all();
+            return;
+         }
+
+         {
+            std::lock_guard lock(_mtx);
+            --_in_flight;
+            _ready.push_back(std::move(t));
+         }
+         _ready_cv.notify_one();
+      }
+   }
+
+   build_fn                 _build;
+   chain_id_type            _chain_id;
+   transaction              _headers;
+   size_t                   _depth;
+   std::mutex               _mtx;
+   std::condition_variable  _ready_cv; // a transaction was signed
+   std::condition_variable  _space;    // a transaction was taken, or the pipeline is stopping
+   std::deque<signed_trx>   _ready;
+   size_t                   _in_flight = 0;
+   uint64_t                 _next_seq  = 0;
+   bool                     _stopping  = false;
+   std::exception_ptr       _error; // what the first failing worker threw
+   std::vector<std::thread> _workers;
+};
+
+} // namespace xyz_load
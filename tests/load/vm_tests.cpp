@@ -0,0 +1,175 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/wasm_interface.hpp>
+#include <fc/io/json.hpp>
+#include "contracts.hpp"
+
+#include "bench_report.hpp"
+#include "eosio.system_tester.hpp"
+
+#include <cstdlib>
+#include <functional>
+#include <map>
+
+using namespace eosio_system;
+
+namespace xyz_vm {
+
+// What `system.wasm` costs on one wasm runtime.
+struct vm_result {
+   std::string               runtime;
+   uint64_t                  wasm_bytes            = 0;
+   int64_t                   deploy_us             = 0; // wall clock time of `setcode`
+   int64_t                   first_call_us         = 0; // first action on code the runtime has never seen
+   int64_t                   warm_call_us          = 0; // the same action once the code is instantiated
+   int64_t                   cold_instantiation_us = 0; // the difference of the two
+   std::vector<bench_sample> actions;                   // steady state, averaged over XYZ_VM_SAMPLES runs
+};
+
+struct vm_runtime {
+   std::string                              name;
+   std::function<void(controller::config&)> configure;
+};
+
+// The runtimes this build of the tester supports.
+std::vector<vm_runtime> supported_runtimes() {
+   std::vector<vm_runtime> runtimes;
+#ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
+   runtimes.push_back({ "eos-vm", [](controller::config& c) { c.wasm_runtime = wasm_interface::vm_type::eos_vm; } });
+#endif
+#ifdef EOSIO_EOS_VM_JIT_RUNTIME_ENABLED
+   runtimes.push_back(
+      { "eos-vm-jit", [](controller::config& c) { c.wasm_runtime = wasm_interface::vm_type::eos_vm_jit; } });
+#endif
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   // OC compiles in the background; until it is done, actions run on the baseline runtime, so OC needs a long
+   // enough warm up (XYZ_VM_WARMUP) for its steady state numbers to be its own.
+   runtimes.push_back({ "eos-vm-oc", [](controller::config& c) {
+                          c.wasm_runtime    = wasm_interface::vm_type::eos_vm_jit;
+                          c.eosvmoc_tierup = wasm_interface::vm_oc_enable::oc_all;
+                       } });
+#endif
+   return runtimes;
+}
+
+// `system.wasm` with a custom section appended. The runtime ignores the section, but the code hash differs, so the
+// chain treats it as code it has never instantiated.
+std::vector<uint8_t> fresh_system_wasm(const std::string& tag) {
+   auto wasm = xyz_contracts::system_wasm();
+
+   const std::string    name = "xyz.vm.bench";
+   std::vector<uint8_t> section{ uint8_t(name.size()) };
+   section.insert(section.end(), name.begin(), name.end());
+   section.insert(section.end(), tag.begin(), tag.end());
+
+   wasm.push_back(0); // custom section id
+   for (size_t size = section.size();;) { // LEB128 size
+      uint8_t byte = size & 0x7f;
+      size >>= 7;
+      wasm.push_back(size ? byte | 0x80 : byte);
+      if (!size)
+         break;
+   }
+   wasm.insert(wasm.end(), section.begin(), section.end());
+   return wasm;
+}
+
+uint32_t env_or(const char* var, uint32_t def) {
+   const char* v = std::getenv(var);
+   return v ? std::strtoul(v, nullptr, 10) : def;
+}
+
+} // namespace xyz_vm
+
+FC_REFLECT(xyz_vm::vm_result,
+           (runtime)(wasm_bytes)(deploy_us)(first_call_us)(warm_call_us)(cold_instantiation_us)(actions))
+
+// How `system.wasm` performs on each wasm runtime the tester supports: deploy time, cold instantiation and first call
+// latency, and steady state CPU of `transfer`, `on_transfer` and `powerup`.
+//
+// Environment:
+//   XYZ_VM_SAMPLES   runs averaged for every steady state number (default: 50)
+//   XYZ_VM_WARMUP    runs of each action before measuring the steady state (default: 20)
+//   XYZ_VM_REPORT    where to write the report (default: xyz_vm_report.json)
+BOOST_AUTO_TEST_SUITE(vm_tests);
+
+BOOST_AUTO_TEST_CASE(runtime_costs) try {
+   using namespace xyz_vm;
+   const uint32_t samples = std::max(1u, env_or("XYZ_VM_SAMPLES", 50));
+   const uint32_t warmup  = env_or("XYZ_VM_WARMUP", 20);
+   const char*    path    = std::getenv("XYZ_VM_REPORT");
+
+   std::vector<vm_result> report;
+   for (const auto& runtime : supported_runtimes()) {
+      configured_system_tester t(runtime.configure);
+      vm_result                r{.runtime = runtime.name};
+
+      const account_name alice = "alice"_n, bob = "bob"_n, cold = "vmcold"_n;
+      t.create_accounts_with_resources({ alice, bob });
+      t.create_account_with_resources(cold, config::system_account_name, 5'000'000); // room for the code
+      t.eosio_token.transfer(t.eos_name, alice, t.eos("100000.0000"));
+      t.eosio_token.transfer(alice, t.xyz_name, t.eos("1000.0000"));
+      t.configure_powerup(t.eos("100.0000"), t.eos("0.0001"));
+      t.produce_block();
+
+      // cold start
+      // ----------
+      const auto wasm = fresh_system_wasm(runtime.name);
+      r.wasm_bytes    = wasm.size();
+      auto start      = fc::time_point::now();
+      t.set_code(cold, wasm);
+      r.deploy_us = (fc::time_point::now() - start).count();
+      t.produce_block();
+
+      // billed_cpu_time_us = 0 bills the measured CPU instead of the tester's fixed default
+      auto run = [&](const std::string& label, action act) {
+         return make_bench_sample(label, t.push_raw({ std::move(act) }, 0));
+      };
+      auto noop = [&](uint32_t n) {
+         return run("noop", action({ { alice, config::active_name } }, cold, "noop"_n,
+                                   fc::raw::pack(std::string("vm ") + std::to_string(n))));
+      };
+      r.first_call_us = noop(0).elapsed_us;
+      t.produce_block();
+
+      std::vector<bench_sample> warm;
+      for (uint32_t n = 1; n <= samples; ++n)
+         warm.push_back(noop(n));
+      r.warm_call_us          = average_samples("noop", warm).elapsed_us;
+      r.cold_instantiation_us = r.first_call_us - r.warm_call_us;
+      t.produce_block();
+
+      // steady state
+      // ------------
+      std::map<std::string, std::vector<bench_sample>> runs;
+      for (uint32_t n = 0; n < warmup + samples; ++n) {
+         const std::string memo = runtime.name + " " + std::to_string(n);
+         std::vector<bench_sample> round{
+            run("transfer",
+                xyz_raw::make_action(t.xyz_name, alice, xyz_raw::transfer{alice, bob, t.xyz("0.0001"), memo})),
+            run("on_transfer", xyz_raw::make_action("eosio.token"_n, alice,
+                                                    xyz_raw::transfer{alice, t.xyz_name, t.eos("0.0001"), memo})),
+            run("powerup", xyz_raw::make_action(t.xyz_name, alice,
+                                                xyz_raw::powerup{alice, alice, 30, powerup_frac / 10'000'000 + n,
+                                                                 powerup_frac / 10'000'000, t.xyz("10.0000")}))};
+         if (n >= warmup)
+            for (auto& s : round)
+               runs[s.label].push_back(std::move(s));
+         t.produce_block();
+      }
+      for (const auto& [label, s] : runs)
+         r.actions.push_back(average_samples(label, s));
+
+      BOOST_TEST_MESSAGE(r.runtime << ": deploy " << r.deploy_us << "us, first call " << r.first_call_us
+                                   << "us, warm call " << r.warm_call_us << "us");
+      for (const auto& s : r.actions)
+         BOOST_TEST_MESSAGE("   " << s.label << ": " << s.elapsed_us << "us elapsed, " << s.billed_cpu_us << "us CPU");
+      report.push_back(std::move(r));
+   }
+   BOOST_REQUIRE_MESSAGE(!report.empty(), "the tester supports no wasm runtime");
+
+   fc::json::save_to_file(fc::variant(report), path ? path : "xyz_vm_report.json", true);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,155 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fc/io/json.hpp>
+#include "contracts.hpp"
+
+#include "bench_report.hpp"
+#include "eosio.system_tester.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <map>
+
+using namespace eosio_system;
+
+namespace xyz_wrapper {
+
+// What the xyz contract adds to an `eosio` action it wraps: the same operation pushed directly on `eosio` with EOS,
+// and through the wrapper with XYZ.
+struct wrapper_overhead {
+   std::string  action;
+   bench_sample direct;
+   bench_sample wrapped;
+   int64_t      extra_cpu_us         = 0;
+   int64_t      extra_elapsed_us     = 0;
+   int64_t      extra_net_bytes      = 0;
+   int64_t      extra_inline_actions = 0;
+   int64_t      extra_ram_bytes      = 0;
+};
+
+wrapper_overhead compare(const std::string& action, bench_sample direct, bench_sample wrapped) {
+   return { .action               = action,
+            .direct               = direct,
+            .wrapped              = wrapped,
+            .extra_cpu_us         = wrapped.billed_cpu_us - direct.billed_cpu_us,
+            .extra_elapsed_us     = wrapped.elapsed_us - direct.elapsed_us,
+            .extra_net_bytes      = int64_t(wrapped.net_bytes) - int64_t(direct.net_bytes),
+            .extra_inline_actions = int64_t(wrapped.inline_actions) - int64_t(direct.inline_actions),
+            .extra_ram_bytes      = wrapped.ram_delta - direct.ram_delta };
+}
+
+// A wrapped action, and its data for `account`, in EOS for `eosio` or in XYZ for the wrapper.
+struct wrapped_action {
+   action_name                                               name;
+   std::function<variant_object(account_name, bool wrapped)> data;
+};
+
+asset tokens(bool wrapped, const char* amount) {
+   return wrapped ? eosio_system_tester::xyz(amount) : eosio_system_tester::eos(amount);
+}
+
+// In the order they are pushed; each round leaves both accounts where they started, give or take RAM and REX.
+std::vector<wrapped_action> wrapped_actions() {
+   const account_name other = "bob"_n;
+   return {
+      { "buyram"_n, [](account_name a, bool w) {
+          return mvo()("payer", a)("receiver", a)("quant", tokens(w, "10.0000"));
+       } },
+      { "buyramself"_n, [](account_name a, bool w) { return mvo()("payer", a)("quant", tokens(w, "10.0000")); } },
+      { "buyrambytes"_n, [](account_name a, bool) { return mvo()("payer", a)("receiver", a)("bytes", 1024); } },
+      { "buyramburn"_n, [](account_name a, bool w) {
+          return mvo()("payer", a)("quantity", tokens(w, "1.0000"))("memo", "");
+       } },
+      { "ramtransfer"_n, [=](account_name a, bool) {
+          return mvo()("from", a)("to", other)("bytes", 512)("memo", "");
+       } },
+      { "ramburn"_n, [](account_name a, bool) { return mvo()("owner", a)("bytes", 256)("memo", ""); } },
+      { "sellram"_n, [](account_name a, bool) { return mvo()("account", a)("bytes", 512); } },
+      { "delegatebw"_n, [](account_name a, bool w) {
+          return mvo()("from", a)("receiver", a)("stake_net_quantity", tokens(w, "5.0000"))(
+             "stake_cpu_quantity", tokens(w, "5.0000"))("transfer", false);
+       } },
+      { "undelegatebw"_n, [](account_name a, bool w) {
+          return mvo()("from", a)("receiver", a)("unstake_net_quantity", tokens(w, "5.0000"))(
+             "unstake_cpu_quantity", tokens(w, "5.0000"));
+       } },
+      { "deposit"_n, [](account_name a, bool w) { return mvo()("owner", a)("amount", tokens(w, "10.0000")); } },
+      { "buyrex"_n, [](account_name a, bool w) { return mvo()("from", a)("amount", tokens(w, "2.0000")); } },
+      { "withdraw"_n, [](account_name a, bool w) { return mvo()("owner", a)("amount", tokens(w, "8.0000")); } },
+      { "powerup"_n, [](account_name a, bool w) {
+          return mvo()("payer", a)("receiver", a)("days", 30)("net_frac", powerup_frac / 10'000'000)(
+             "cpu_frac", powerup_frac / 10'000'000)("max_payment", tokens(w, "10.0000"));
+       } },
+   };
+}
+
+} // namespace xyz_wrapper
+
+FC_REFLECT(xyz_wrapper::wrapper_overhead, (action)(direct)(wrapped)(extra_cpu_us)(extra_elapsed_us)(extra_net_bytes)(
+                                             extra_inline_actions)(extra_ram_bytes))
+
+// The cost the swap layer adds to each wrapped action. Two accounts in the same state push the same operations, one
+// directly on `eosio` with EOS and the other through the xyz contract with XYZ, and the report gives the difference,
+// most expensive wrapper first.
+//
+// Environment:
+//   XYZ_WRAPPER_ROUNDS   rounds of all the actions, averaged, after an unmeasured warm-up round (default: 5)
+//   XYZ_WRAPPER_REPORT   where to write the report (default: xyz_wrapper_report.json)
+BOOST_AUTO_TEST_SUITE(wrapper_tests);
+
+BOOST_FIXTURE_TEST_CASE(wrapped_vs_direct, eosio_system_tester) try {
+   using namespace xyz_wrapper;
+   const char*    rounds_env = std::getenv("XYZ_WRAPPER_ROUNDS");
+   const char*    path       = std::getenv("XYZ_WRAPPER_REPORT");
+   const uint32_t rounds     = std::max(1ul, rounds_env ? std::strtoul(rounds_env, nullptr, 10) : 5ul);
+
+   const account_name direct = "direct"_n, wrapped = "wrapped"_n;
+   create_accounts_with_resources({ direct, wrapped, "bob"_n });
+   for (auto a : { direct, wrapped })
+      eosio_token.transfer(eos_name, a, eos("100000.0000"));
+   eosio_token.transfer(wrapped, xyz_name, eos("50000.0000"));
+   configure_powerup(eos("100.0000"), eos("0.0001"));
+   produce_block();
+
+   // billed_cpu_time_us = 0 bills the measured CPU instead of the tester's fixed default
+   auto run = [&](account_name code, const wrapped_action& a, account_name who, bool w) {
+      auto act = get_action(code, a.name, { { who, config::active_name } }, a.data(who, w));
+      return make_bench_sample(a.name.to_string(), push_raw({ act }, 0));
+   };
+
+   // Round 0 is a warm-up that is not measured: the first debit of `wrapped` releases its balance row (241 more bytes)
+   // and the first call of each action emplaces its usage counter and hourly row, one-time costs that would otherwise
+   // land on the first round.
+   const auto                                       actions = wrapped_actions();
+   std::map<std::string, std::vector<bench_sample>> direct_runs, wrapped_runs;
+   for (uint32_t r = 0; r <= rounds; ++r) {
+      for (const auto& a : actions) {
+         auto d = run(eos_name, a, direct, false);
+         auto w = run(xyz_name, a, wrapped, true);
+         if (r > 0) {
+            direct_runs[a.name.to_string()].push_back(std::move(d));
+            wrapped_runs[a.name.to_string()].push_back(std::move(w));
+         }
+         produce_block();
+      }
+   }
+
+   std::vector<wrapper_overhead> report;
+   for (const auto& a : actions) {
+      const auto label = a.name.to_string();
+      report.push_back(
+         compare(label, average_samples(label, direct_runs[label]), average_samples(label, wrapped_runs[label])));
+   }
+   std::sort(report.begin(), report.end(),
+             [](const auto& x, const auto& y) { return x.extra_cpu_us > y.extra_cpu_us; });
+
+   for (const auto& o : report)
+      BOOST_TEST_MESSAGE(o.action << ": +" << o.extra_cpu_us << "us CPU (" << o.direct.billed_cpu_us << " -> "
+                                  << o.wrapped.billed_cpu_us << "), +" << o.extra_net_bytes << " NET, +"
+                                  << o.extra_inline_actions << " inline, +" << o.extra_ram_bytes << " RAM");
+   fc::json::save_to_file(fc::variant(report), path ? path : "xyz_wrapper_report.json", true);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
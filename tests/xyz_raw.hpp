@@ -0,0 +1,121 @@
+#pragma once
+
+#include <eosio/chain/action.hpp>
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/name.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <string>
+#include <vector>
+
+// Typed copies of the action data and table rows the load generators use, packed and unpacked with fc::raw instead of
+// going through `mutable_variant_object` and `abi_serializer`. Members must stay in the order of the contracts'
+// structs (contracts/include/system/system.entry.hpp, and eosio.token / eosio.system for `transfer`, `buyrambytes`
+// and `delegatebw`). Trailing binary extensions are left out: the contract reads them as absent and ignores them in
+// the rows.
+namespace xyz_raw {
+
+using namespace eosio::chain;
+
+// actions
+// -------
+
+// `transfer` of eosio.token and of the xyz contract
+struct transfer {
+   name        from;
+   name        to;
+   asset       quantity;
+   std::string memo;
+
+   static action_name get_name() { return "transfer"_n; }
+};
+
+struct swapto {
+   name        from;
+   name        to;
+   asset       quantity;
+   std::string memo;
+
+   static action_name get_name() { return "swapto"_n; }
+};
+
+struct powerup {
+   name     payer;
+   name     receiver;
+   uint32_t days     = 0;
+   int64_t  net_frac = 0;
+   int64_t  cpu_frac = 0;
+   asset    max_payment;
+
+   static action_name get_name() { return "powerup"_n; }
+};
+
+struct blockswapto {
+   name account;
+   bool block = false;
+
+   static action_name get_name() { return "blockswapto"_n; }
+};
+
+struct bulk_credit {
+   name  account;
+   asset quantity;
+};
+
+struct bulkcredit {
+   name                     batch;
+   uint64_t                 offset = 0;
+   std::vector<bulk_credit> credits;
+
+   static action_name get_name() { return "bulkcredit"_n; }
+};
+
+struct buyrambytes {
+   name     payer;
+   name     receiver;
+   uint32_t bytes = 0;
+
+   static action_name get_name() { return "buyrambytes"_n; }
+};
+
+struct delegatebw {
+   name  from;
+   name  receiver;
+   asset stake_net_quantity;
+   asset stake_cpu_quantity;
+   bool  transfer = false;
+
+   static action_name get_name() { return "delegatebw"_n; }
+};
+
+template <typename Data>
+action make_action(name code, std::vector<permission_level> auths, const Data& data) {
+   return action(std::move(auths), code, Data::get_name(), fc::raw::pack(data));
+}
+
+template <typename Data>
+action make_action(name code, name actor, const Data& data) {
+   return make_action(code, { { actor, config::active_name } }, data);
+}
+
+// rows
+// ----
+
+// `accounts` row of eosio.token, and the first member of the xyz contract's
+struct token_account {
+   asset balance;
+};
+
+} // namespace xyz_raw
+
+FC_REFLECT(xyz_raw::transfer, (from)(to)(quantity)(memo))
+FC_REFLECT(xyz_raw::swapto, (from)(to)(quantity)(memo))
+FC_REFLECT(xyz_raw::powerup, (payer)(receiver)(days)(net_frac)(cpu_frac)(max_payment))
+FC_REFLECT(xyz_raw::blockswapto, (account)(block))
+FC_REFLECT(xyz_raw::bulk_credit, (account)(quantity))
+FC_REFLECT(xyz_raw::bulkcredit, (batch)(offset)(credits))
+FC_REFLECT(xyz_raw::buyrambytes, (payer)(receiver)(bytes))
+FC_REFLECT(xyz_raw::delegatebw, (from)(receiver)(stake_net_quantity)(stake_cpu_quantity)(transfer))
+FC_REFLECT(xyz_raw::token_account, (balance))
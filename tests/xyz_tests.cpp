@@ -18,31 +18,6 @@ std::vector<char> prepare_wasm(const std::vector<uint8_t>& uint8_vector) {
     return char_vector;
 }
 
-inline constexpr int64_t powerup_frac  = 1'000'000'000'000'000ll; // 1.0 = 10^15
-inline constexpr int64_t stake_weight = 100'000'000'0000ll; // 10^12
-
-struct powerup_config_resource {
-   std::optional<int64_t>        current_weight_ratio = {};
-   std::optional<int64_t>        target_weight_ratio  = {};
-   std::optional<int64_t>        assumed_stake_weight = {};
-   std::optional<time_point_sec> target_timestamp     = {};
-   std::optional<double>         exponent             = {};
-   std::optional<uint32_t>       decay_secs           = {};
-   std::optional<asset>          min_price            = {};
-   std::optional<asset>          max_price            = {};
-};
-FC_REFLECT(powerup_config_resource,                                                             //
-           (current_weight_ratio)(target_weight_ratio)(assumed_stake_weight)(target_timestamp) //
-           (exponent)(decay_secs)(min_price)(max_price))
-
-struct powerup_config {
-   powerup_config_resource net             = {};
-   powerup_config_resource cpu             = {};
-   std::optional<uint32_t> powerup_days    = {};
-   std::optional<asset>    min_powerup_fee = {};
-};
-FC_REFLECT(powerup_config, (net)(cpu)(powerup_days)(min_powerup_fee))
-
 
 using namespace eosio_system;
 
@@ -109,6 +84,681 @@ BOOST_FIXTURE_TEST_CASE(transfer_and_swapto, eosio_system_tester) try {
 
 } FC_LOG_AND_RETHROW()
 
+// ----------------------------
+// test: `swapto` and `transfer` nonces
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(nonces, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n, "carol"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+   const account_name carol = accounts[2];
+
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(eos_name, bob,   eos("100.0000"));
+
+   // a retried `swapto` with the same nonce is rejected instead of withdrawing twice
+   // -------------------------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(alice, carol, eos("5.0000"), 1), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(alice, carol, eos("5.0000"), 1),
+                       error("Nonce already used, this request was already executed"));
+   BOOST_REQUIRE(check_balances(alice, { eos("95.0000"), xyz("0.0000") }));
+   BOOST_REQUIRE(check_balances(carol, { eos("0.0000"),  xyz("5.0000") }));
+
+   // nonces are per account, and requests without a nonce are not tracked
+   // ---------------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(bob, carol, eos("5.0000"), 1), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(alice, carol, eos("5.0000")), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(alice, carol, eos("5.0000")), success());
+   BOOST_REQUIRE(check_balances(carol, { eos("0.0000"),  xyz("20.0000") }));
+
+   // `transfer` shares the same nonces as `swapto`
+   // ---------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(carol, alice, xyz("1.0000"), 7), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(carol, alice, xyz("1.0000"), 7),
+                       error("Nonce already used, this request was already executed"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(carol, alice, xyz("1.0000"), 7),
+                       error("Nonce already used, this request was already executed"));
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(alice), xyz("1.0000"));
+
+   // nonces expire and can be reused afterwards
+   // ------------------------------------------
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(alice, carol, eos("5.0000"), 1), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(carol, alice, xyz("1.0000"), 7), success());
+   BOOST_REQUIRE(check_balances(carol, { eos("0.0000"),  xyz("23.0000") }));
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `setrelaykey`, `relayswaps`
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(relayswaps, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n, "relayer"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice   = accounts[0];
+   const account_name bob     = accounts[1];
+   const account_name relayer = accounts[2];
+
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(eos_name, bob,   eos("100.0000"));
+
+   auto relay = [&](const std::vector<fc::variant>& intents) -> action_result {
+      try {
+         base_tester::push_action(xyz_name, "relayswaps"_n, relayer, mvo()("intents", intents));
+      } catch (const eosio_assert_message_exception& e) {
+         return error(e.top_message().substr(strlen("assertion failure with message: ")));
+      }
+      produce_block();
+      return success();
+   };
+   const auto expiry = time_point_sec(control->head().block_time()) + 3600;
+
+   // intents can only be relayed for accounts that registered a key
+   // ---------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(relay({ signed_swap_intent(alice, eos("10.0000"), 1, expiry) }),
+                       error("No relay key registered for account"));
+
+   base_tester::push_action(xyz_name, "setrelaykey"_n, alice, mvo()
+      ("account", alice)
+      ("key",     get_public_key(alice, "active"))
+   );
+   base_tester::push_action(xyz_name, "setrelaykey"_n, bob, mvo()
+      ("account", bob)
+      ("key",     get_public_key(bob, "active"))
+   );
+
+   // one relayer transaction swaps for several accounts, in both directions
+   // ------------------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(relay({ signed_swap_intent(alice, eos("10.0000"), 1, expiry),
+                               signed_swap_intent(bob,   eos("20.0000"), 1, expiry),
+                               signed_swap_intent(alice, xyz("4.0000"),  2, expiry) }), success());
+   BOOST_REQUIRE(check_balances(alice, { eos("94.0000"), xyz("6.0000") }));
+   BOOST_REQUIRE(check_balances(bob,   { eos("80.0000"), xyz("20.0000") }));
+
+   // replays, expired intents and forged signatures are rejected
+   // ------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(relay({ signed_swap_intent(alice, xyz("1.0000"), 2, expiry) }),
+                       error("Intent nonce already used"));
+   BOOST_REQUIRE_EQUAL(relay({ signed_swap_intent(alice, xyz("1.0000"), 3, expiry - 7200) }),
+                       error("Intent expired"));
+
+   auto forged = signed_swap_intent(bob, xyz("1.0000"), 3, expiry).get_object();
+   forged = mvo(forged)("account", alice);
+   BOOST_REQUIRE_EQUAL(relay({ forged }), error("Invalid intent signature"));
+
+   // an intent signed for another chain cannot be replayed on this one
+   const chain_id_type other_chain(fc::sha256::hash(std::string("another chain")));
+   BOOST_REQUIRE_EQUAL(relay({ signed_swap_intent(alice, xyz("1.0000"), 3, expiry, other_chain) }),
+                       error("Invalid intent signature"));
+
+   BOOST_REQUIRE(check_balances(alice, { eos("94.0000"), xyz("6.0000") }));
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `queueswap`, `processq`
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(swap_queue, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n, "carol"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+   const account_name carol = accounts[2];
+
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(eos_name, bob,   eos("100.0000"));
+
+   auto queueswap = [&](account_name account, const asset& quantity) {
+      base_tester::push_action(xyz_name, "queueswap"_n, account, mvo()("account", account)("quantity", quantity));
+   };
+   auto processq = [&](uint32_t max_items) {
+      base_tester::push_action(xyz_name, "processq"_n, carol, mvo()("max_items", max_items));
+      produce_block();
+   };
+
+   BOOST_REQUIRE_EXCEPTION(processq(10), eosio_assert_message_exception,
+                           eosio_assert_message_is("Nothing to process"));
+   BOOST_REQUIRE_EXCEPTION(queueswap(alice, asset::from_string("1.0000 BOGUS")), eosio_assert_message_exception,
+                           eosio_assert_message_is("Invalid symbol"));
+
+   queueswap(alice, eos("10.0000"));
+   queueswap(bob,   eos("20.0000"));
+   queueswap(alice, eos("95.0000"));   // more than alice will have left, dropped when processed
+   queueswap(alice, xyz("4.0000"));
+   produce_block();
+
+   // nothing moves until the queue is processed
+   BOOST_REQUIRE(check_balances(alice, { eos("100.0000"), xyz("0.0000") }));
+
+   // processing stops at the cursor and resumes from it
+   // --------------------------------------------------
+   processq(2);
+   BOOST_REQUIRE(check_balances(alice, { eos("90.0000"), xyz("10.0000") }));
+   BOOST_REQUIRE(check_balances(bob,   { eos("80.0000"), xyz("20.0000") }));
+
+   processq(10);
+   BOOST_REQUIRE(check_balances(alice, { eos("94.0000"), xyz("6.0000") }));
+
+   BOOST_REQUIRE_EXCEPTION(processq(10), eosio_assert_message_exception,
+                           eosio_assert_message_is("Nothing to process"));
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `swapall`
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(swapall, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapall(alice, symbol(SY(4, BOGUS))), error("Invalid symbol"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapall(bob, eos_symbol()), error("Nothing to swap"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapall(bob, xyz_symbol()), error("no balance object found"));
+
+   // convert all EOS to XYZ
+   // ----------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapall(alice, eos_symbol()), success());
+   BOOST_REQUIRE(check_balances(alice, { eos("0.0000"), xyz("100.0000") }));
+
+   // convert all XYZ back to EOS
+   // ---------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapall(alice, xyz_symbol()), success());
+   BOOST_REQUIRE(check_balances(alice, { eos("100.0000"), xyz("0.0000") }));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapall(alice, xyz_symbol()), error("Nothing to swap"));
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(xyz_name), xyz("2100000000.0000"));      // everything is back in reserve
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `aggregates` table
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(aggregates, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+
+   auto circulating   = [&]() { return get_xyz_aggregates()["circulating"].as<asset>(); };
+   auto holders       = [&]() { return get_xyz_aggregates()["holders"].as<uint64_t>(); };
+   auto contract_rows = [&]() { return get_xyz_aggregates()["contract_rows"].as<uint64_t>(); };
+   auto contract_ram  = [&]() { return get_xyz_aggregates()["contract_ram_bytes"].as<uint64_t>(); };
+   auto sponsored     = [&]() { return get_xyz_aggregates()["sponsored_rows"].as<uint64_t>(); };
+   auto consistent    = [&]() { return circulating() == xyz("2100000000.0000") - get_xyz_balance(xyz_name); };
+
+   BOOST_REQUIRE(consistent());
+   const uint64_t holders_before = holders();
+   const uint64_t rows_before    = contract_rows();
+
+   // swapping in creates a contract-paid row for a new holder
+   // --------------------------------------------------------
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(alice, xyz_name, eos("100.0000"));
+   BOOST_REQUIRE(consistent());
+   BOOST_REQUIRE_EQUAL(holders(), holders_before + 1);
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before + 1);
+   BOOST_REQUIRE_EQUAL(contract_ram(), contract_rows() * 241);
+
+   // alice's first debit releases her row, bob gets a contract-paid one
+   // -------------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, bob, xyz("40.0000")), success());
+   BOOST_REQUIRE(consistent());
+   BOOST_REQUIRE_EQUAL(holders(), holders_before + 2);
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before + 1);
+
+   // swapping everything out drops alice from the holders
+   // ----------------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, xyz_name, xyz("60.0000")), success());
+   BOOST_REQUIRE(consistent());
+   BOOST_REQUIRE_EQUAL(holders(), holders_before + 1);
+   base_tester::push_action(xyz_name, "close"_n, alice, mvo()("owner", alice)("symbol", xyz_symbol()));
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before + 1);
+
+   // a row a third party opens is sponsored, not contract-paid, until its first credit
+   // ----------------------------------------------------------------------------------
+   base_tester::push_action(xyz_name, "release"_n, bob, mvo()("owner", bob));
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before);
+   const uint64_t sponsored_before = sponsored();
+
+   base_tester::push_action(xyz_name, "open"_n, bob, mvo()("owner", alice)("symbol", xyz_symbol())("ram_payer", bob));
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(alice), 0);
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before);
+   BOOST_REQUIRE_EQUAL(sponsored(), sponsored_before + 1);
+   base_tester::push_action(xyz_name, "close"_n, alice, mvo()("owner", alice)("symbol", xyz_symbol()));
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before);
+   BOOST_REQUIRE_EQUAL(sponsored(), sponsored_before);
+
+   base_tester::push_action(xyz_name, "open"_n, bob, mvo()("owner", alice)("symbol", xyz_symbol())("ram_payer", bob));
+   base_tester::push_action(xyz_name, "release"_n, alice, mvo()("owner", alice));
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before);
+   BOOST_REQUIRE_EQUAL(sponsored(), sponsored_before);
+   base_tester::push_action(xyz_name, "close"_n, alice, mvo()("owner", alice)("symbol", xyz_symbol()));
+
+   base_tester::push_action(xyz_name, "open"_n, bob, mvo()("owner", alice)("symbol", xyz_symbol())("ram_payer", bob));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(bob, alice, xyz("1.0000")), success());
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before + 1); // counted with the rows holding a balance from now on
+   BOOST_REQUIRE_EQUAL(sponsored(), sponsored_before);
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, bob, xyz("1.0000")), success());
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(alice), 1);
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows_before);
+
+   // only the contract can seed the counters
+   // ---------------------------------------
+   BOOST_REQUIRE_EXCEPTION(base_tester::push_action(xyz_name, "setaggr"_n, alice,
+                                                    mvo()("holders", 7)("contract_rows", 3)),
+                           missing_auth_exception, fc_exception_message_is("missing authority of core.vaulta"));
+   base_tester::push_action(xyz_name, "setaggr"_n, xyz_name, mvo()("holders", 7)("contract_rows", 3));
+   BOOST_REQUIRE_EQUAL(holders(), 7u);
+   BOOST_REQUIRE_EQUAL(contract_ram(), 3u * 241);
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: contract-paid rows never drain to zero
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(no_empty_contract_rows, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+
+   auto contract_rows = [&]() { return get_xyz_aggregates()["contract_rows"].as<uint64_t>(); };
+
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(alice, xyz_name, eos("100.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(alice), 0);
+   const uint64_t rows = contract_rows();
+
+   // draining the balance hands the row over to its owner on the first debit
+   // -------------------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, bob, xyz("100.0000")), success());
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(alice), xyz("0.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(alice), 1);
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows);   // alice's row was released, bob's was created
+
+   // and the same for swapping everything back out
+   // ---------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(bob, xyz_name, xyz("100.0000")), success());
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(bob), 1);
+   BOOST_REQUIRE_EQUAL(contract_rows(), rows - 1);
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `release`, and what it costs compared to releasing on the first debit
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(release, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n, "carol"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+   const account_name carol = accounts[2];
+
+   for (auto a : { alice, bob }) {
+      eosio_token.transfer(eos_name, a, eos("100.0000"));
+      eosio_token.transfer(a, xyz_name, eos("100.0000"));
+   }
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(alice), 0);
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(bob), 0);
+
+   auto push = [&](account_name signer, action_name act, const variant_object& data) {
+      auto trace = base_tester::push_action(xyz_name, act, signer, data);
+      produce_block();
+      return trace;
+   };
+   auto transfer = [&](account_name from) {
+      return push(from, "transfer"_n, mvo()("from", from)("to", carol)("quantity", xyz("1.0000"))("memo", ""));
+   };
+
+   // released on the first debit
+   // ---------------------------
+   auto alice_ram   = get_account_ram(alice);
+   transfer(alice);
+   BOOST_REQUIRE_EQUAL(get_account_ram(alice) - alice_ram, -241);
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(alice), 1);
+
+   // released ahead of time, the debit is then a plain modify
+   // --------------------------------------------------------
+   auto bob_ram  = get_account_ram(bob);
+   push(bob, "release"_n, mvo()("owner", bob));
+   BOOST_REQUIRE_EQUAL(get_account_ram(bob) - bob_ram, -241);
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(bob), 1);
+   transfer(bob);
+   BOOST_REQUIRE_EQUAL(get_account_ram(bob) - bob_ram, -241);
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(bob), xyz("99.0000"));
+
+   BOOST_REQUIRE_EXCEPTION(push(bob, "release"_n, mvo()("owner", bob)), eosio_assert_message_exception,
+                           eosio_assert_message_is("Balance row is already released"));
+   BOOST_REQUIRE_EXCEPTION(push(xyz_name, "release"_n, mvo()("owner", "nobody"_n)), missing_auth_exception,
+                           fc_exception_message_is("missing authority of nobody"));
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: versioned rows, `migrate`, `migrateaccts`
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(versioned_rows, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+
+   auto migrate = [&](account_name signer, uint32_t max_rows) {
+      base_tester::push_action(xyz_name, "migrate"_n, signer, mvo()("max_rows", max_rows));
+      produce_block();
+   };
+   auto account_row = [&](account_name owner) {
+      return get_row_by_account(xyz_name, owner, "accounts"_n, account_name(xyz_symbol().to_symbol_code().value));
+   };
+   auto migrate_state = [&]() {
+      return get_row_by_account(xyz_name, xyz_name, "migratestate"_n, "migratestate"_n);
+   };
+
+   // rows that were never upgraded carry no version byte, so versioning costs no RAM
+   // --------------------------------------------------------------------------------
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(alice, xyz_name, eos("100.0000"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, bob, xyz("1.0000")), success());
+   BOOST_REQUIRE_EQUAL(account_row(alice).size(), 17u);   // asset + released
+   BOOST_REQUIRE_EQUAL(account_row(bob).size(), 17u);
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(alice), 1);
+
+   BOOST_REQUIRE_EXCEPTION(migrate(alice, 10), missing_auth_exception,
+                           fc_exception_message_is("missing authority of core.vaulta"));
+   BOOST_REQUIRE_EXCEPTION(migrate(xyz_name, 0), eosio_assert_message_exception,
+                           eosio_assert_message_is("max_rows must be greater than 0"));
+
+   // a pass can be split over several calls, and leaves nothing behind once it is done
+   // ----------------------------------------------------------------------------------
+   migrate(xyz_name, 1);
+   BOOST_REQUIRE(!migrate_state().empty());
+   migrate(xyz_name, 100);
+   BOOST_REQUIRE(migrate_state().empty());
+
+   base_tester::push_action(xyz_name, "migrateaccts"_n, xyz_name, mvo()("owners", std::vector<name>{ alice, bob }));
+   BOOST_REQUIRE_EQUAL(account_row(alice).size(), 17u);
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(bob), xyz("1.0000"));
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: upgrading versioned rows, with the `system_v1` test build that puts every row at version 1
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(versioned_row_upgrade, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n, "carol"_n, "dave"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+   const account_name carol = accounts[2];
+   const account_name dave  = accounts[3];
+
+   const name sym_code(xyz_symbol().to_symbol_code().value);
+   auto account_row = [&](account_name owner) { return get_row_by_account(xyz_name, owner, "accounts"_n, sym_code); };
+   auto account_version = [&](account_name owner) {
+      auto row = xyz_abi_ser.binary_to_variant("account", account_row(owner), abi_serializer_max_time);
+      return row["version"].as<uint8_t>();
+   };
+   auto config_row  = [&]() { return get_row_by_account(xyz_name, xyz_name, "config"_n, "config"_n); };
+   auto stat_row    = [&]() { return get_row_by_account(xyz_name, sym_code, "stat"_n, sym_code); };
+   auto blocked_row = [&](account_name a) { return get_row_by_account(xyz_name, xyz_name, "blocked"_n, a); };
+   auto migrate     = [&](uint32_t max_rows) {
+      base_tester::push_action(xyz_name, "migrate"_n, xyz_name, mvo()("max_rows", max_rows));
+      produce_block();
+   };
+   auto migrate_state = [&]() { return get_row_by_account(xyz_name, xyz_name, "migratestate"_n, "migratestate"_n); };
+
+   // rows written at version 0 carry no version byte
+   // ------------------------------------------------
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(eos_name, dave, eos("100.0000"));
+   eosio_token.transfer(alice, xyz_name, eos("100.0000"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, bob, xyz("10.0000")), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, carol, xyz("10.0000")), success());
+   base_tester::push_action(xyz_name, "blockswapto"_n, carol, mvo()("account", carol)("block", true));
+
+   BOOST_REQUIRE_EQUAL(account_row(alice).size(), 17u); // asset + released
+   BOOST_REQUIRE_EQUAL(account_row(bob).size(), 17u);
+   BOOST_REQUIRE_EQUAL(account_row(carol).size(), 17u);
+   BOOST_REQUIRE_EQUAL(config_row().size(), 8u);        // symbol
+   BOOST_REQUIRE_EQUAL(stat_row().size(), 40u);         // supply + max_supply + issuer
+   BOOST_REQUIRE_EQUAL(blocked_row(carol).size(), 8u);  // account
+
+   set_code_and_abi(xyz_name, xyz_contracts::system_v1_wasm(), xyz_contracts::system_v1_abi().data());
+   produce_block();
+
+   // rows are upgraded when the contract writes them, and new rows are created at the current version
+   // --------------------------------------------------------------------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, bob, xyz("1.0000")), success());
+   BOOST_REQUIRE_EQUAL(account_row(alice).size(), 18u);
+   BOOST_REQUIRE_EQUAL(account_version(alice), 1);
+   BOOST_REQUIRE_EQUAL(account_row(bob).size(), 18u);
+   BOOST_REQUIRE_EQUAL(account_version(bob), 1);
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(alice), xyz("79.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(bob), xyz("11.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(bob), 0); // upgrading keeps the rest of the row
+
+   eosio_token.transfer(dave, xyz_name, eos("10.0000"));
+   BOOST_REQUIRE_EQUAL(account_row(dave).size(), 18u);
+   BOOST_REQUIRE_EQUAL(account_version(dave), 1);
+
+   // `migrateaccts` upgrades balance rows nothing wrote
+   // ---------------------------------------------------
+   BOOST_REQUIRE_EQUAL(account_row(carol).size(), 17u);
+   base_tester::push_action(xyz_name, "migrateaccts"_n, xyz_name, mvo()("owners", std::vector<name>{ carol, bob }));
+   BOOST_REQUIRE_EQUAL(account_row(carol).size(), 18u);
+   BOOST_REQUIRE_EQUAL(account_version(carol), 1);
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(carol), xyz("10.0000"));
+
+   // a `migrate` pass upgrades `config`, `stat` and `blocked`, over as many calls as it takes
+   // -----------------------------------------------------------------------------------------
+   migrate(1);
+   BOOST_REQUIRE_EQUAL(config_row().size(), 9u);
+   BOOST_REQUIRE_EQUAL(stat_row().size(), 40u);
+   BOOST_REQUIRE(!migrate_state().empty());
+
+   migrate(100);
+   BOOST_REQUIRE_EQUAL(stat_row().size(), 41u);
+   BOOST_REQUIRE_EQUAL(blocked_row(carol).size(), 9u);
+   BOOST_REQUIRE(migrate_state().empty());
+
+   // a second pass finds nothing left to upgrade
+   migrate(100);
+   BOOST_REQUIRE_EQUAL(config_row().size(), 9u);
+   BOOST_REQUIRE_EQUAL(stat_row().size(), 41u);
+   BOOST_REQUIRE_EQUAL(blocked_row(carol).size(), 9u);
+
+   // and the upgraded rows read as before
+   // ------------------------------------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.swapto(alice, carol, xyz("1.0000")),
+                       error("Recipient is blocked from receiving swapped tokens: carol"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(carol, bob, xyz("10.0000")), success());
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(bob), xyz("21.0000"));
+   BOOST_REQUIRE(audit_xyz(alice)["solvent"].as<bool>());
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `audit`
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(audit, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+
+   auto before = audit_xyz(alice);
+   BOOST_REQUIRE(before["solvent"].as<bool>());
+   BOOST_REQUIRE_EQUAL(before["supply"].as<asset>(), xyz("2100000000.0000"));
+   BOOST_REQUIRE_EQUAL(before["outstanding"].as<asset>(),
+                       before["supply"].as<asset>() - before["reserve"].as<asset>());
+
+   // swaps in both directions keep the EOS held equal to the XYZ outstanding plus the surplus
+   // -----------------------------------------------------------------------------------------
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(alice, xyz_name, eos("100.0000"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.buyram(alice, alice, xyz("30.0000")), success());
+
+   auto after = audit_xyz(alice);
+   BOOST_REQUIRE(after["solvent"].as<bool>());
+   BOOST_REQUIRE_EQUAL(after["outstanding"].as<asset>(), before["outstanding"].as<asset>() + xyz("70.0000"));
+   BOOST_REQUIRE_EQUAL(after["eos_balance"].as<asset>(), before["eos_balance"].as<asset>() + eos("70.0000"));
+   BOOST_REQUIRE_EQUAL(after["surplus"].as<asset>(), before["surplus"].as<asset>());
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `bulkcredit`
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(bulkcredit, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n, "carol"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+   const account_name carol = accounts[2];
+
+   auto credit = [&](account_name account, const asset& quantity) {
+      return mvo()("account", account)("quantity", quantity);
+   };
+   auto bulkcredit = [&](account_name signer, name batch, uint64_t offset, const std::vector<fc::variant>& credits) {
+      base_tester::push_action(xyz_name, "bulkcredit"_n, signer,
+                               mvo()("batch", batch)("offset", offset)("credits", credits));
+      produce_block();
+   };
+
+   const asset reserve = get_xyz_balance(xyz_name);
+
+   BOOST_REQUIRE_EXCEPTION(bulkcredit(alice, "legacy"_n, 0, { credit(alice, xyz("1.0000")) }), missing_auth_exception,
+                           fc_exception_message_is("missing authority of core.vaulta"));
+   BOOST_REQUIRE_EXCEPTION(bulkcredit(xyz_name, "legacy"_n, 1, { credit(alice, xyz("1.0000")) }),
+                           eosio_assert_message_exception, eosio_assert_message_is("Expected offset 0 for this batch"));
+   BOOST_REQUIRE_EXCEPTION(bulkcredit(xyz_name, "legacy"_n, 0, { credit(alice, eos("1.0000")) }),
+                           eosio_assert_message_exception, eosio_assert_message_is("Invalid symbol"));
+   BOOST_REQUIRE_EXCEPTION(bulkcredit(xyz_name, "legacy"_n, 0, { credit("nobody"_n, xyz("1.0000")) }),
+                           eosio_assert_message_exception, eosio_assert_message_is("account does not exist: nobody"));
+
+   // a batch sent in two chunks
+   // --------------------------
+   bulkcredit(xyz_name, "legacy"_n, 0, { credit(alice, xyz("10.0000")), credit(bob, xyz("20.0000")) });
+   bulkcredit(xyz_name, "legacy"_n, 2, { credit(carol, xyz("30.0000")), credit(alice, xyz("5.0000")) });
+
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(alice), xyz("15.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(bob), xyz("20.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(carol), xyz("30.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(xyz_name), reserve - xyz("65.0000"));
+   BOOST_REQUIRE_EQUAL(get_xyz_account_released(carol), 0);   // paid for by the contract
+
+   // replaying a chunk that was already applied is rejected
+   BOOST_REQUIRE_EXCEPTION(bulkcredit(xyz_name, "legacy"_n, 2, { credit(carol, xyz("30.0000")) }),
+                           eosio_assert_message_exception, eosio_assert_message_is("Expected offset 4 for this batch"));
+
+   // other batches have their own cursor
+   bulkcredit(xyz_name, "airdrop"_n, 0, { credit(bob, xyz("1.0000")) });
+   BOOST_REQUIRE_EQUAL(get_xyz_balance(bob), xyz("21.0000"));
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `counters` table
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(usage_counters, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+   const account_name bob   = accounts[1];
+
+   auto calls      = [&](name action) { return get_usage(action)["calls"].as<uint64_t>(); };
+   auto eos_to_xyz = [&](name action) { return get_usage(action)["eos_to_xyz"].as<int64_t>(); };
+   auto xyz_to_eos = [&](name action) { return get_usage(action)["xyz_to_eos"].as<int64_t>(); };
+
+   const int64_t swapped_in = eos_to_xyz("transfer"_n);
+
+   // every EOS to XYZ swap is recorded under `transfer`
+   // ---------------------------------------------------
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+   eosio_token.transfer(eos_name, bob,   eos("100.0000"));
+   eosio_token.transfer(alice, xyz_name, eos("100.0000"));
+   eosio_token.transfer(bob,   xyz_name, eos("100.0000"));
+   BOOST_REQUIRE_EQUAL(eos_to_xyz("transfer"_n), swapped_in + 2000000);
+
+   // wrapped actions count their calls and what they swapped before forwarding
+   // --------------------------------------------------------------------------
+   const uint64_t buyram_calls = calls("buyram"_n);
+   const int64_t  buyram_spent = xyz_to_eos("buyram"_n);
+   BOOST_REQUIRE_EQUAL(eosio_xyz.buyram(alice, alice, xyz("10.0000")), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.buyram(bob, bob, xyz("5.0000")), success());
+   BOOST_REQUIRE_EQUAL(calls("buyram"_n), buyram_calls + 2);
+   BOOST_REQUIRE_EQUAL(xyz_to_eos("buyram"_n), buyram_spent + 150000);
+   BOOST_REQUIRE_EQUAL(eos_to_xyz("buyram"_n), 0);
+
+   // swapping XYZ back through a transfer to the contract
+   // ----------------------------------------------------
+   const int64_t swapped_out = xyz_to_eos("transfer"_n);
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, xyz_name, xyz("20.0000")), success());
+   BOOST_REQUIRE_EQUAL(xyz_to_eos("transfer"_n), swapped_out + 200000);
+
+   // what counting costs the contract: the first call under an action (per shard) or in an hour adds a row it
+   // pays for, later calls update those rows in place
+   // ---------------------------------------------------------------------------------------------------------
+   auto contract_ram = [&]() { return control->get_resource_limits_manager().get_account_ram_usage(xyz_name); };
+
+   // start from a fresh hour so that both calls below land in the same bucket
+   produce_block(fc::seconds(3600 - control->pending_block_time().sec_since_epoch() % 3600));
+   BOOST_REQUIRE_EQUAL(calls("buyramself"_n), 0u);
+
+   const int64_t cold_ram = contract_ram();
+   BOOST_REQUIRE_EQUAL(eosio_xyz.buyramself(alice, xyz("1.0000")), success());
+   const int64_t first_call_bytes = contract_ram() - cold_ram;
+   BOOST_REQUIRE_GT(first_call_bytes, 0);
+
+   const int64_t warm_ram = contract_ram();
+   BOOST_REQUIRE_EQUAL(eosio_xyz.buyramself(alice, xyz("1.0000")), success());
+   BOOST_REQUIRE_EQUAL(contract_ram(), warm_ram);
+   BOOST_REQUIRE_EQUAL(calls("buyramself"_n), 2u);
+   BOOST_TEST_MESSAGE("counting a call costs the contract " << first_call_bytes << " bytes the first time, 0 after");
+
+} FC_LOG_AND_RETHROW()
+
+// ----------------------------
+// test: `hourly` ring buffer
+// ----------------------------
+BOOST_FIXTURE_TEST_CASE(hourly_volume, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice = accounts[0];
+
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+
+   // start from a fresh hour so that the bucket only holds what this test does
+   produce_block(fc::hours(system_usage::hourly_slots));
+   produce_block(fc::seconds(3600 - control->pending_block_time().sec_since_epoch() % 3600));
+
+   eosio_token.transfer(alice, xyz_name, eos("50.0000"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.buyram(alice, alice, xyz("10.0000")), success());
+   BOOST_REQUIRE_EQUAL(eosio_xyz.transfer(alice, xyz_name, xyz("5.0000")), success());
+
+   auto bucket = get_current_hourly();
+   BOOST_REQUIRE_EQUAL(bucket["eos_to_xyz"].as<int64_t>(), 500000);
+   BOOST_REQUIRE_EQUAL(bucket["xyz_to_eos"].as<int64_t>(), 150000);
+   BOOST_REQUIRE_EQUAL(bucket["swaps"].as<uint64_t>(), 3u);
+   BOOST_REQUIRE_EQUAL(bucket["wrapped_calls"].as<uint64_t>(), 1u);
+
+   // a week later the same slot is reused for the new hour
+   // ------------------------------------------------------
+   const uint32_t hour = bucket["hour"].as<uint32_t>();
+   produce_block(fc::hours(system_usage::hourly_slots));
+   eosio_token.transfer(alice, xyz_name, eos("1.0000"));
+
+   bucket = get_current_hourly();
+   BOOST_REQUIRE_EQUAL(bucket["hour"].as<uint32_t>(), hour + system_usage::hourly_slots);
+   BOOST_REQUIRE_EQUAL(bucket["eos_to_xyz"].as<int64_t>(), 10000);
+   BOOST_REQUIRE_EQUAL(bucket["swaps"].as<uint64_t>(), 1u);
+   BOOST_REQUIRE_EQUAL(bucket["wrapped_calls"].as<uint64_t>(), 0u);
+
+} FC_LOG_AND_RETHROW()
+
 // ----------------------------
 // test: `bidname`, `bidrefund`
 // ----------------------------
@@ -367,6 +1017,84 @@ BOOST_FIXTURE_TEST_CASE(rex_tests, eosio_system_tester) try {
 
 } FC_LOG_AND_RETHROW()
 
+// --------------------------------------------------------------------------------
+// test: rexin, rexout
+// --------------------------------------------------------------------------------
+BOOST_FIXTURE_TEST_CASE(rex_in_out, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n, "bob"_n };
+   create_accounts_with_resources( accounts );
+   const account_name bob = accounts[1];
+
+   eosio_token.transfer(eos_name, bob, eos("100.0000"));
+
+   // rexin
+   // -----
+   BOOST_REQUIRE_EQUAL(eosio_xyz.rexin(bob, xyz("0.0000")), error("Swap before amount must be greater than 0"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.rexin(bob, eos("1.0000")), error("Wrong token used"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.rexin(bob, xyz("1.0000")), error("no balance object found"));
+
+   BOOST_REQUIRE_EQUAL(eosio_token.transfer(bob, xyz_name, eos("50.0000")), success()); // swap 50 EOS to XYZ
+   BOOST_REQUIRE_EQUAL(eosio_xyz.rexin(bob, xyz("10.0000")), success());
+   BOOST_REQUIRE(check_balances(bob, { eos("50.0000"), xyz("40.0000") }));
+   BOOST_REQUIRE_EQUAL(get_rex_balance(bob), rex(100000'0000u));
+   BOOST_REQUIRE_EQUAL(get_rex_fund(bob), eos("0.0000"));                   // everything deposited was used
+
+   // rexout
+   // ------
+   BOOST_REQUIRE_EQUAL(eosio_xyz.rexout(bob, xyz("1.0000")), error("asset must be a positive amount of (REX, 4)"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.rexout(bob, rex(100000'0000u)), error("insufficient available rex"));
+   produce_block( fc::days(30) ); // must wait
+
+   BOOST_REQUIRE_EQUAL(eosio_xyz.rexout(bob, rex(100000'0000u)), success());
+   BOOST_REQUIRE(check_balances(bob, { eos("50.0000"), xyz("50.0000") }));  // proceeds came back as XYZ
+   BOOST_REQUIRE_EQUAL(get_rex_balance(bob), rex(0u));
+   BOOST_REQUIRE_EQUAL(get_rex_fund(bob), eos("0.0000"));
+
+   // usage is counted under the wrapper, not the `fundexcess` helper
+   BOOST_REQUIRE_EQUAL(get_usage("rexout"_n)["calls"].as<uint64_t>(), 1u);
+   BOOST_REQUIRE_EQUAL(get_usage("fundexcess"_n)["calls"].as<uint64_t>(), 0u);
+
+} FC_LOG_AND_RETHROW()
+
+// --------------------------------------------------------------------------------
+// test: createacct
+// --------------------------------------------------------------------------------
+BOOST_FIXTURE_TEST_CASE(createacct, eosio_system_tester) try {
+   const std::vector<account_name> accounts = { "alice"_n };
+   create_accounts_with_resources( accounts );
+   const account_name alice  = accounts[0];
+   const account_name newacc = "newacc"_n;
+   const auto         key    = get_public_key(newacc, "active");
+
+   eosio_token.transfer(eos_name, alice, eos("100.0000"));
+
+   BOOST_REQUIRE_EQUAL(eosio_xyz.createacct(alice, newacc, key, 8000, eos("1.0000"), xyz("1.0000")),
+                       error("Wrong token used"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.createacct(alice, newacc, key, 8000, xyz("1.0000"), xyz("-1.0000")),
+                       error("must stake a non-negative amount"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.createacct(alice, newacc, key, 0, xyz("0.0000"), xyz("0.0000")),
+                       error("must buy RAM or stake a positive amount"));
+   BOOST_REQUIRE_EQUAL(eosio_xyz.createacct(alice, newacc, key, 8000, xyz("1.0000"), xyz("1.0000")),
+                       error("no balance object found"));
+
+   // to use the xyz contract, Alice needs to have some XYZ tokens.
+   BOOST_REQUIRE_EQUAL(eosio_token.transfer(alice, xyz_name, eos("50.0000")), success()); // swap 50 EOS to XYZ
+   BOOST_REQUIRE(check_balances(alice, { eos("50.0000"), xyz("50.0000") }));
+
+   BOOST_REQUIRE_EQUAL(eosio_xyz.createacct(alice, newacc, key, 8000, xyz("1.0000"), xyz("2.0000")), success());
+
+   // account exists with the requested RAM and stake, and only XYZ was spent
+   BOOST_REQUIRE_GE(get_ram_bytes(newacc), 8000);
+   BOOST_REQUIRE_EQUAL(get_total_stake(newacc)["net_weight"].as<asset>(), eos("1.0000"));
+   BOOST_REQUIRE_EQUAL(get_total_stake(newacc)["cpu_weight"].as<asset>(), eos("2.0000"));
+   BOOST_REQUIRE_EQUAL(get_eos_balance(alice), eos("50.0000"));
+   BOOST_REQUIRE_LT(get_xyz_balance(alice), xyz("47.0000"));
+
+   BOOST_REQUIRE_EQUAL(eosio_xyz.createacct(alice, newacc, key, 8000, xyz("1.0000"), xyz("1.0000")),
+                       error("Cannot create account named newacc, as that name is already taken"));
+
+} FC_LOG_AND_RETHROW()
+
 
 const account_name issuer = "issuer"_n;
 const account_name swapper = "swapper"_n;
@@ -1452,6 +2180,42 @@ BOOST_FIXTURE_TEST_CASE( misc, eosio_system_tester ) try {
             missing_auth_exception,
             fc_exception_message_is("missing authority of defproducera")
         );
+
+        // should swap the rewards to XYZ when the owner can't buy REX yet, instead of failing the claim
+        produce_block( fc::days(1) );
+        auto xyz_unvoted = get_xyz_balance(producer);
+        auto rex_unvoted = get_rex_balance(producer);
+        base_tester::push_action( xyz_name, "claimrewards"_n, producer, mutable_variant_object()
+            ("owner",    producer)
+            ("restake",  true)
+        );
+
+        BOOST_REQUIRE_EQUAL(get_xyz_balance(producer) > xyz_unvoted, true);
+        BOOST_REQUIRE_EQUAL(get_rex_balance(producer), rex_unvoted);
+
+        // should be able to compound rewards into REX instead of swapping them to XYZ
+        base_tester::push_action( eos_name, "voteproducer"_n, producer, mutable_variant_object()
+            ("voter",    producer)
+            ("proxy",    ""_n)
+            ("producers", producers)
+        );
+        produce_block( fc::days(1) );
+
+        auto xyz_before   = get_xyz_balance(producer);
+        auto eos_before   = get_balance(producer);
+        auto rex_before   = get_rex_balance(producer);
+        auto calls_before = get_usage("claimrewards"_n)["calls"].as<uint64_t>();
+        base_tester::push_action( xyz_name, "claimrewards"_n, producer, mutable_variant_object()
+            ("owner",    producer)
+            ("restake",  true)
+        );
+
+        BOOST_REQUIRE_EQUAL(get_xyz_balance(producer), xyz_before);
+        BOOST_REQUIRE_EQUAL(get_balance(producer), eos_before);
+        BOOST_REQUIRE_EQUAL(get_rex_balance(producer) > rex_before, true);
+        // counted under the wrapper, not the `rexexcess` helper
+        BOOST_REQUIRE_EQUAL(get_usage("claimrewards"_n)["calls"].as<uint64_t>(), calls_before + 1);
+        BOOST_REQUIRE_EQUAL(get_usage("rexexcess"_n)["calls"].as<uint64_t>(), 0u);
     }
 
     // linkauth
@@ -1566,33 +2330,7 @@ BOOST_FIXTURE_TEST_CASE( misc, eosio_system_tester ) try {
 
     // should be able to powerup and get overages back in XYZ
     {
-        // configure powerup
-        {
-            powerup_config config;
-
-            config.net.current_weight_ratio = powerup_frac / 4;
-            config.net.target_weight_ratio  = powerup_frac / 100;
-            config.net.assumed_stake_weight = stake_weight;
-            config.net.target_timestamp     = time_point_sec(get_pending_block_time() + fc::days(100));
-            config.net.exponent             = 2;
-            config.net.decay_secs           = fc::days(1).to_seconds();
-            config.net.min_price            = asset::from_string("0.0000 EOS");
-            config.net.max_price            = asset::from_string("1000000.0000 EOS");
-
-            config.cpu.current_weight_ratio = powerup_frac / 4;
-            config.cpu.target_weight_ratio  = powerup_frac / 100;
-            config.cpu.assumed_stake_weight = stake_weight;
-            config.cpu.target_timestamp     = time_point_sec(get_pending_block_time() + fc::days(100));
-            config.cpu.exponent             = 2;
-            config.cpu.decay_secs           = fc::days(1).to_seconds();
-            config.cpu.min_price            = asset::from_string("0.0000 EOS");
-            config.cpu.max_price            = asset::from_string("1000000.0000 EOS");
-
-            config.powerup_days    = 30;
-            config.min_powerup_fee = asset::from_string("1.0000 EOS");
-
-            base_tester::push_action(eos_name, "cfgpowerup"_n, eos_name, mvo()("args", config));
-        }
+        configure_powerup();
 
         auto old_balance = get_xyz_balance(powerupuser);
 